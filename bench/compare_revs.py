@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""Time minic as built from several git revisions on the same inputs.
+
+Usage: compare_revs.py [--clang-dir DIR] [-n N] [--flag F]... REV... -- a.c...
+
+Every REV is checked out in a temporary worktree and built in Release mode
+against the Clang package in DIR (as find_package(Clang) takes it), then
+`minic [F...] a.c` is run N times per input. The median wall time and the
+peak RSS of each input are printed per revision, with the ratio to the
+first REV, so that a change is measured as its parent against itself:
+
+    compare_revs.py abc123~ abc123 -- build/bench/corpus/*.c
+
+Only the minic executable is used, so this also works on revisions from
+before minic_bench and --stats.
+"""
+import argparse
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def build(src, clang_dir):
+    out = os.path.join(src, "build")
+    args = ["cmake", "-S", src, "-B", out, "-DCMAKE_BUILD_TYPE=Release"]
+    if clang_dir:
+        args.append(f"-DClang_DIR={clang_dir}")
+    subprocess.run(args, check=True, stdout=subprocess.DEVNULL)
+    subprocess.run(["cmake", "--build", out, "--target", "minic", "-j",
+                    str(os.cpu_count())], check=True, stdout=subprocess.DEVNULL)
+    return os.path.join(out, "minic")
+
+
+def run(minic, flags, path):
+    start = time.perf_counter()
+    proc = subprocess.Popen([minic, *flags, path], stdout=subprocess.DEVNULL)
+    _, status, usage = os.wait4(proc.pid, 0)
+    elapsed = time.perf_counter() - start
+    if status:
+        sys.exit(f"{minic} {path}: exit status {status}")
+    # ru_maxrss is in KiB on Linux.
+    return elapsed, usage.ru_maxrss * 1024
+
+
+def main():
+    argv = sys.argv[1:]
+    if "--" not in argv:
+        sys.exit(__doc__)
+    split = argv.index("--")
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--clang-dir")
+    ap.add_argument("-n", type=int, default=5)
+    ap.add_argument("--flag", action="append", default=[])
+    ap.add_argument("revs", nargs="+")
+    opts = ap.parse_args(argv[:split])
+    inputs = [os.path.abspath(p) for p in argv[split + 1:]]
+    repo = subprocess.run(["git", "rev-parse", "--show-toplevel"],
+                          check=True, capture_output=True,
+                          text=True).stdout.strip()
+
+    results = {}
+    with tempfile.TemporaryDirectory() as tmp:
+        for i, rev in enumerate(opts.revs):
+            src = os.path.join(tmp, str(i))
+            subprocess.run(["git", "-C", repo, "worktree", "add", "--detach",
+                            src, rev], check=True, stdout=subprocess.DEVNULL)
+            try:
+                minic = build(src, opts.clang_dir)
+                for path in inputs:
+                    runs = [run(minic, opts.flag, path) for _ in range(opts.n)]
+                    results[rev, path] = (
+                        statistics.median(t for t, _ in runs),
+                        max(rss for _, rss in runs))
+            finally:
+                subprocess.run(["git", "-C", repo, "worktree", "remove",
+                                "--force", src])
+
+    mb = 1 << 20
+    print(f"{'input':<24} {'rev':<12} {'ms':>9} {'RSS MiB':>8} "
+          f"{'time':>6} {'RSS':>6}")
+    for path in inputs:
+        base_t, base_rss = results[opts.revs[0], path]
+        for rev in opts.revs:
+            t, rss = results[rev, path]
+            print(f"{os.path.basename(path):<24} {rev[:12]:<12} "
+                  f"{t * 1e3:9.1f} {rss / mb:8.1f} {t / base_t:6.2f} "
+                  f"{rss / base_rss:6.2f}")
+
+
+if __name__ == "__main__":
+    main()
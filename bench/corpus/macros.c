@@ -0,0 +1,141 @@
+/* Macro-heavy C: X-macros, token pasting, stringizing and generic
+ * containers generated by the preprocessor. */
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define OPCODES(X)                                                             \
+  X(nop, 0)                                                                    \
+  X(push, 1)                                                                   \
+  X(pop, 0)                                                                    \
+  X(add, 0)                                                                    \
+  X(sub, 0)                                                                    \
+  X(mul, 0)                                                                    \
+  X(div, 0)                                                                    \
+  X(jump, 1)                                                                   \
+  X(jump_if_zero, 1)                                                           \
+  X(print, 0)                                                                  \
+  X(halt, 0)
+
+#define AS_ENUM(name, operands) OP_##name,
+enum opcode { OPCODES(AS_ENUM) OP_COUNT };
+#undef AS_ENUM
+
+#define AS_NAME(name, operands) #name,
+static const char *const opcode_names[] = {OPCODES(AS_NAME)};
+#undef AS_NAME
+
+#define AS_OPERANDS(name, operands) operands,
+static const int opcode_operands[] = {OPCODES(AS_OPERANDS)};
+#undef AS_OPERANDS
+
+#define DEFINE_VECTOR(type, prefix)                                            \
+  struct prefix##_vector {                                                     \
+    type *items;                                                               \
+    size_t length, capacity;                                                   \
+  };                                                                           \
+  static int prefix##_push(struct prefix##_vector *vector, type item) {        \
+    if (vector->length == vector->capacity) {                                  \
+      size_t grown = vector->capacity ? vector->capacity * 2 : 8;              \
+      type *items = realloc(vector->items, grown * sizeof *items);             \
+      if (!items)                                                              \
+        return -1;                                                             \
+      vector->items = items;                                                   \
+      vector->capacity = grown;                                                \
+    }                                                                          \
+    vector->items[vector->length++] = item;                                    \
+    return 0;                                                                  \
+  }                                                                            \
+  static type prefix##_pop(struct prefix##_vector *vector) {                   \
+    return vector->items[--vector->length];                                    \
+  }                                                                            \
+  static void prefix##_free(struct prefix##_vector *vector) {                  \
+    free(vector->items);                                                       \
+    memset(vector, 0, sizeof *vector);                                         \
+  }
+
+DEFINE_VECTOR(long, stack)
+DEFINE_VECTOR(unsigned char, code)
+DEFINE_VECTOR(const char *, text)
+
+#define CHECK(condition, message)                                              \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      text_push(&errors, message " (" #condition ")");                         \
+      return -1;                                                               \
+    }                                                                          \
+  } while (0)
+
+#define BINARY(name, operator)                                                 \
+  case OP_##name: {                                                            \
+    CHECK(stack.length >= 2, "stack underflow in " #name);                     \
+    long right = stack_pop(&stack), left = stack_pop(&stack);                  \
+    stack_push(&stack, left operator right);                                   \
+    break;                                                                     \
+  }
+
+static struct text_vector errors;
+
+static int run(const struct code_vector *program, long *result) {
+  struct stack_vector stack = {0};
+  size_t pc = 0;
+  while (pc < program->length) {
+    enum opcode op = (enum opcode)program->items[pc++];
+    CHECK(op < OP_COUNT, "bad opcode");
+    long operand = 0;
+    if (opcode_operands[op]) {
+      CHECK(pc < program->length, "truncated operand");
+      operand = (signed char)program->items[pc++];
+    }
+    switch (op) {
+    case OP_nop:
+      break;
+    case OP_push:
+      stack_push(&stack, operand);
+      break;
+    case OP_pop:
+      CHECK(stack.length, "stack underflow in pop");
+      stack_pop(&stack);
+      break;
+      BINARY(add, +)
+      BINARY(sub, -)
+      BINARY(mul, *)
+    case OP_div: {
+      CHECK(stack.length >= 2, "stack underflow in div");
+      long right = stack_pop(&stack), left = stack_pop(&stack);
+      CHECK(right, "division by zero");
+      stack_push(&stack, left / right);
+      break;
+    }
+    case OP_jump:
+      pc += operand;
+      break;
+    case OP_jump_if_zero:
+      CHECK(stack.length, "stack underflow in " "jump_if_zero");
+      if (!stack_pop(&stack))
+        pc += operand;
+      break;
+    case OP_print:
+    case OP_halt:
+    case OP_COUNT:
+      pc = program->length;
+      break;
+    }
+  }
+  *result = stack.length ? stack.items[stack.length - 1] : 0;
+  stack_free(&stack);
+  return 0;
+}
+
+int main(void) {
+  static const unsigned char source[] = {OP_push, 6, OP_push, 7, OP_mul,
+                                         OP_print, OP_halt};
+  struct code_vector program = {0};
+  for (size_t i = 0; i < sizeof source; i++)
+    code_push(&program, source[i]);
+  long result;
+  int status = run(&program, &result);
+  code_free(&program);
+  text_free(&errors);
+  return status ? 1 : (int)(result != 42) + (opcode_names[0][0] != 'n');
+}
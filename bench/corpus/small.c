@@ -0,0 +1,85 @@
+/* A small, ordinary C program: a word-frequency counter. */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TABLE_SIZE 4096
+#define MAX_WORD 64
+
+struct entry {
+  char word[MAX_WORD];
+  unsigned count;
+  struct entry *next;
+};
+
+static struct entry *table[TABLE_SIZE];
+
+static unsigned hash_word(const char *word) {
+  unsigned hash = 5381;
+  for (; *word; word++)
+    hash = hash * 33 + (unsigned char)*word;
+  return hash % TABLE_SIZE;
+}
+
+static struct entry *lookup_or_insert(const char *word) {
+  unsigned bucket = hash_word(word);
+  struct entry *current;
+  for (current = table[bucket]; current; current = current->next)
+    if (!strcmp(current->word, word))
+      return current;
+  current = calloc(1, sizeof *current);
+  if (!current) {
+    perror("calloc");
+    exit(1);
+  }
+  strncpy(current->word, word, MAX_WORD - 1);
+  current->next = table[bucket];
+  table[bucket] = current;
+  return current;
+}
+
+static int compare_entries(const void *left, const void *right) {
+  const struct entry *const *a = left, *const *b = right;
+  if ((*a)->count != (*b)->count)
+    return (*a)->count < (*b)->count ? 1 : -1;
+  return strcmp((*a)->word, (*b)->word);
+}
+
+static size_t read_words(FILE *input) {
+  char buffer[MAX_WORD];
+  size_t length = 0, distinct = 0;
+  int character;
+  while ((character = fgetc(input)) != EOF) {
+    if (isalnum(character) && length + 1 < MAX_WORD) {
+      buffer[length++] = (char)tolower(character);
+      continue;
+    }
+    if (length) {
+      buffer[length] = '\0';
+      struct entry *found = lookup_or_insert(buffer);
+      if (!found->count++)
+        distinct++;
+      length = 0;
+    }
+  }
+  return distinct;
+}
+
+int main(int argc, char **argv) {
+  FILE *input = argc > 1 ? fopen(argv[1], "r") : stdin;
+  if (!input) {
+    perror(argv[1]);
+    return 1;
+  }
+  size_t distinct = read_words(input), filled = 0;
+  struct entry **sorted = malloc(distinct * sizeof *sorted);
+  for (unsigned bucket = 0; bucket < TABLE_SIZE; bucket++)
+    for (struct entry *item = table[bucket]; item; item = item->next)
+      sorted[filled++] = item;
+  qsort(sorted, filled, sizeof *sorted, compare_entries);
+  for (size_t index = 0; index < filled && index < 20; index++)
+    printf("%7u %s\n", sorted[index]->count, sorted[index]->word);
+  free(sorted);
+  return 0;
+}
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Generate the large members of the minic_bench corpus.
+
+Usage: gen_corpus.py OUTDIR
+
+Writes large.c (about 1 MB of ordinary C), amalgamation.c (about 8 MB, many
+modules pasted into one TU the way SQLite ships) and templates.cc
+(template-heavy C++). The output is deterministic, so a stored baseline stays
+comparable; the small hand-written inputs live in corpus/.
+"""
+import os
+import sys
+
+from template_members import generate as generate_templates
+
+
+def module(i):
+    """One self-contained module of about 10 KB with unique names."""
+    out = [f"/* module {i} */",
+           f"enum state_{i} {{ STATE_{i}_IDLE, STATE_{i}_BUSY,"
+           f" STATE_{i}_DONE }};",
+           f"struct record_{i} {{",
+           "  int identifier;",
+           "  long accumulated_total;",
+           "  double running_average;",
+           f"  enum state_{i} current_state;",
+           f"  struct record_{i} *next_record;",
+           "};",
+           f"static struct record_{i} records_{i}[64];",
+           f"static int record_count_{i};"]
+    for f in range(12):
+        out += [f"static long update_{i}_{f}(struct record_{i} *record,"
+                " long increment) {",
+                "  long previous_total = record->accumulated_total;",
+                "  for (int iteration = 0; iteration < 4; iteration++) {",
+                "    long scaled_increment = increment * (iteration + 1);",
+                "    record->accumulated_total += scaled_increment;",
+                "    if (record->accumulated_total > 1000000)",
+                f"      record->current_state = STATE_{i}_DONE;",
+                "  }",
+                "  record->running_average ="
+                " (record->running_average + increment) / 2;",
+                "  return record->accumulated_total - previous_total;",
+                "}"]
+    out += [f"long run_module_{i}(long seed) {{",
+            "  long checksum = 0;",
+            f"  for (int index = 0; index < 64; index++) {{",
+            f"    struct record_{i} *record = &records_{i}[index];",
+            "    record->identifier = index;",
+            f"    record->next_record = index + 1 < 64 ?"
+            f" &records_{i}[index + 1] : 0;"]
+    for f in range(12):
+        out.append(f"    checksum += update_{i}_{f}(record, seed + {f});")
+    out += ["  }",
+            f"  record_count_{i} = 64;",
+            "  return checksum;",
+            "}"]
+    return "\n".join(out) + "\n"
+
+
+def program(modules):
+    body = "".join(module(i) for i in range(modules))
+    calls = "".join(f"  total += run_module_{i}(total);\n"
+                    for i in range(modules))
+    return body + "int main(void) {\n  long total = 1;\n" + calls + \
+        "  return (int)(total & 0x7f);\n}\n"
+
+
+def main():
+    outdir = sys.argv[1]
+    os.makedirs(outdir, exist_ok=True)
+    files = {
+        "large.c": program(140),
+        "amalgamation.c": program(1100),
+        "templates.cc": generate_templates(20, 100, 8),
+    }
+    for name, text in files.items():
+        with open(os.path.join(outdir, name), "w") as f:
+            f.write(text)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,196 @@
+#include <err.h>
+#include <stdio.h>
+#include <sys/resource.h>
+
+#include "common.h"
+#include "minic.h"
+
+namespace {
+struct Phase {
+  const char *name;
+  double minic::Timings::*field;
+};
+
+const Phase PHASES[] = {
+    {"driver", &minic::Timings::driver},
+    {"parse", &minic::Timings::parse},
+    {"collect", &minic::Timings::collect},
+    {"names", &minic::Timings::names},
+    {"rename", &minic::Timings::rename},
+    {"apply", &minic::Timings::apply},
+    {"reformat", &minic::Timings::reformat},
+    {"postprocess", &minic::Timings::postProcess},
+};
+} // namespace
+
+static double median(std::vector<double> samples) {
+  llvm::sort(samples);
+  return samples[samples.size() / 2];
+}
+
+// Start counting the peak resident set size again from the current one.
+// Linux only; elsewhere the peak stays that of the whole process.
+static void resetPeakRSS() {
+  if (FILE *f = fopen("/proc/self/clear_refs", "w")) {
+    fputs("5", f);
+    fclose(f);
+  }
+}
+
+// Peak resident set size since resetPeakRSS, in MiB.
+static double peakRSS() {
+  if (FILE *f = fopen("/proc/self/status", "r")) {
+    char line[256];
+    unsigned long kib = 0;
+    bool found = false;
+    while (!found && fgets(line, sizeof line, f))
+      found = sscanf(line, "VmHWM: %lu kB", &kib) == 1;
+    fclose(f);
+    if (found)
+      return kib / 1024.0;
+  }
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_maxrss / 1024.0;
+}
+
+int main(int argc, char *argv[]) {
+  unsigned runs = 5;
+  double threshold = 0.25, floorMs = 1;
+  const char *baselinePath = nullptr;
+  bool update = false, reformat = false, lexicalOnly = false;
+  std::vector<std::string> inputs;
+  const char usage[] =
+      R"(Usage: %s [-n runs] [--baseline file [--update] [--threshold x]
+          [--min-ms ms]] [--reformat | --lexical-only] input...
+
+Minify every input runs times and print the median time of each phase, the
+throughput and the peak RSS while minifying that input. With --baseline,
+exit with status 1 if a phase got slower than the stored median by more than
+a fraction x (default 0.25) and more than ms milliseconds (default 1), or if
+the baseline file is missing. --update writes the current numbers to it
+instead.
+)";
+  for (int i = 1; i < argc; i++) {
+    StringRef opt(argv[i]);
+    if (opt[0] != '-')
+      inputs.push_back(argv[i]);
+    else if (opt == "-n" && i + 1 < argc &&
+             !StringRef(argv[i + 1]).getAsInteger(10, runs) && runs)
+      i++;
+    else if (opt == "--baseline" && i + 1 < argc)
+      baselinePath = argv[++i];
+    else if (opt == "--update")
+      update = true;
+    else if (opt == "--threshold" && i + 1 < argc &&
+             !StringRef(argv[i + 1]).getAsDouble(threshold))
+      i++;
+    else if (opt == "--min-ms" && i + 1 < argc &&
+             !StringRef(argv[i + 1]).getAsDouble(floorMs))
+      i++;
+    else if (opt == "--reformat")
+      reformat = true;
+    else if (opt == "--lexical-only")
+      lexicalOnly = true;
+    else {
+      fprintf(stderr, usage, argv[0]);
+      return 1;
+    }
+  }
+  if (inputs.empty()) {
+    fprintf(stderr, usage, argv[0]);
+    return 1;
+  }
+
+  json::Object baseline;
+  bool haveBaseline = false;
+  if (baselinePath && !update) {
+    // A gate that records whatever the first run gives would always pass.
+    auto buf = MemoryBuffer::getFile(baselinePath);
+    if (!buf)
+      errx(1, "%s: %s; write one with --update", baselinePath,
+           buf.getError().message().c_str());
+    auto parsed = json::parse((*buf)->getBuffer());
+    if (!parsed)
+      errx(1, "%s: %s", baselinePath, toString(parsed.takeError()).c_str());
+    json::Object *obj = parsed->getAsObject();
+    if (!obj)
+      errx(1, "%s: not a JSON object", baselinePath);
+    baseline = std::move(*obj);
+    haveBaseline = true;
+  }
+
+  const SmallVector<StringRef, 0> ignores{"main"};
+  minic::Options opts;
+  opts.ignores = ignores;
+  opts.reformat = reformat;
+  opts.lexicalOnly = lexicalOnly;
+
+  printf("%-18s", "input");
+  for (const Phase &phase : PHASES)
+    printf(" %11s", phase.name);
+  printf(" %9s %8s %8s\n", "total ms", "MB/s", "RSS MiB");
+
+  json::Object results;
+  int regressions = 0;
+  for (const std::string &input : inputs) {
+    auto buf = MemoryBuffer::getFile(input);
+    if (!buf)
+      errx(1, "%s: %s", input.c_str(), buf.getError().message().c_str());
+    StringRef code = (*buf)->getBuffer();
+    const char *args[] = {argv[0], "-fsyntax-only",
+                          "-I/usr/lib/clang/18/include", input.c_str()};
+
+    resetPeakRSS();
+    std::vector<minic::Timings> samples(runs);
+    for (minic::Timings &timings : samples) {
+      opts.timings = &timings;
+      auto res = minic::minify(code, args, opts);
+      if (!res)
+        errx(1, "%s: %s", input.c_str(), toString(res.takeError()).c_str());
+    }
+
+    StringRef name = sys::path::filename(input);
+    json::Object row;
+    std::vector<double> totals(runs);
+    printf("%-18s", name.str().c_str());
+    for (const Phase &phase : PHASES) {
+      std::vector<double> ms;
+      for (unsigned i = 0; i != runs; i++) {
+        ms.push_back(samples[i].*phase.field * 1e3);
+        totals[i] += ms.back();
+      }
+      double med = median(ms);
+      row[phase.name] = med;
+      printf(" %11.2f", med);
+    }
+    double total = median(totals);
+    row["total"] = total;
+    printf(" %9.2f %8.2f %8.1f\n", total, code.size() / 1e3 / total,
+           peakRSS());
+
+    if (haveBaseline)
+      if (const json::Object *base = baseline.getObject(name))
+        for (auto &[phase, value] : row) {
+          auto old = base->getNumber(phase);
+          double cur = *value.getAsNumber();
+          if (old && cur > *old * (1 + threshold) && cur - *old > floorMs) {
+            fprintf(stderr, "%s: %s regressed: %.2f ms -> %.2f ms\n",
+                    name.str().c_str(), StringRef(phase).str().c_str(), *old,
+                    cur);
+            regressions++;
+          }
+        }
+    results[name] = std::move(row);
+  }
+
+  if (baselinePath && update) {
+    std::error_code ec;
+    raw_fd_ostream os(baselinePath, ec);
+    if (ec)
+      errx(1, "%s: %s", baselinePath, ec.message().c_str());
+    os << formatv("{0:2}", json::Value(std::move(results))) << '\n';
+    fprintf(stderr, "wrote baseline %s\n", baselinePath);
+  }
+  return regressions ? 1 : 0;
+}
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""Compare per-request latency of `minic --serve` with cold CLI runs.
+
+Usage: serve_latency.py [--minic PATH] [-n N] a.c [b.c ...]
+
+Every input is minified N times through a fresh `minic a.c` process and N
+times through one long-lived `minic --serve`; p50/p99 are printed for both.
+"""
+import argparse
+import statistics
+import subprocess
+import time
+
+
+def percentile(samples, p):
+    samples = sorted(samples)
+    return samples[min(len(samples) - 1, int(len(samples) * p / 100))]
+
+
+def report(name, samples):
+    print(f"{name:>6}: p50 {percentile(samples, 50) * 1e3:8.2f} ms"
+          f"  p99 {percentile(samples, 99) * 1e3:8.2f} ms"
+          f"  mean {statistics.mean(samples) * 1e3:8.2f} ms")
+
+
+def request(server, path, source):
+    server.stdin.write(f"1 {len(source)}\n{path}\n".encode() + source)
+    server.stdin.flush()
+    status, length = server.stdout.readline().split()
+    body = server.stdout.read(int(length))
+    if status != b"ok":
+        raise SystemExit(f"{path}: {body.decode()}")
+    return body
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--minic", default="minic")
+    ap.add_argument("-n", type=int, default=100)
+    ap.add_argument("inputs", nargs="+")
+    opts = ap.parse_args()
+    sources = {path: open(path, "rb").read() for path in opts.inputs}
+
+    cold = []
+    for _ in range(opts.n):
+        for path in opts.inputs:
+            start = time.perf_counter()
+            subprocess.run([opts.minic, path], check=True,
+                           stdout=subprocess.DEVNULL)
+            cold.append(time.perf_counter() - start)
+
+    server = subprocess.Popen([opts.minic, "--serve"], stdin=subprocess.PIPE,
+                              stdout=subprocess.PIPE)
+    # The first request pays for the cold caches; keep it out of the numbers.
+    for path, source in sources.items():
+        request(server, path, source)
+    warm = []
+    for _ in range(opts.n):
+        for path, source in sources.items():
+            start = time.perf_counter()
+            request(server, path, source)
+            warm.append(time.perf_counter() - start)
+    server.stdin.close()
+    server.wait()
+
+    report("cold", cold)
+    report("warm", warm)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""Time minic on member-heavy class templates, header-only-library style.
+
+Usage: template_members.py [--minic PATH] [--templates T] [--members M]
+                           [--instances I] [-n N] [--keep FILE]
+
+Generates T class templates with M data members and M member functions each,
+instantiates every template with I distinct types and touches every member
+of every instantiation, then reports the best of N runs of `minic` on it.
+Member lookups through specializations grow as T * I * M, so this is the
+input that shows the cost of resolving a member back to its primary
+template.
+"""
+import argparse
+import os
+import subprocess
+import tempfile
+import time
+
+
+def generate(templates, members, instances):
+    out = []
+    for t in range(templates):
+        out.append(f"template <typename T> struct container_{t} {{")
+        for m in range(members):
+            out.append(f"  T value_{m};")
+        for m in range(members):
+            out.append(f"  T get_{m}() const {{ return value_{m}; }}")
+        out.append("};")
+    for i in range(instances):
+        out.append(f"struct element_{i} {{ int payload; }};")
+    out.append("int main() {")
+    out.append("  int sum = 0;")
+    for t in range(templates):
+        for i in range(instances):
+            var = f"c_{t}_{i}"
+            out.append(f"  container_{t}<element_{i}> {var}{{}};")
+            for m in range(members):
+                out.append(f"  sum += {var}.value_{m}.payload"
+                           f" + {var}.get_{m}().payload;")
+    out.append("  return sum;")
+    out.append("}")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--minic", default="minic")
+    ap.add_argument("--templates", type=int, default=20)
+    ap.add_argument("--members", type=int, default=200)
+    ap.add_argument("--instances", type=int, default=10)
+    ap.add_argument("-n", type=int, default=5)
+    ap.add_argument("--keep", help="also write the generated input here")
+    opts = ap.parse_args()
+
+    source = generate(opts.templates, opts.members, opts.instances)
+    if opts.keep:
+        with open(opts.keep, "w") as f:
+            f.write(source)
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join(tmp, "templates.cc")
+        with open(path, "w") as f:
+            f.write(source)
+        times = []
+        for _ in range(opts.n):
+            start = time.perf_counter()
+            subprocess.run([opts.minic, path], check=True,
+                           stdout=subprocess.DEVNULL)
+            times.append(time.perf_counter() - start)
+    print(f"{len(source)} bytes, best of {opts.n}: {min(times) * 1e3:.1f} ms")
+
+
+if __name__ == "__main__":
+    main()
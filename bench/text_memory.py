@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+"""Measure how much memory minic's text pipeline needs on a huge input.
+
+Usage: text_memory.py [--minic PATH] [--mb SIZE]
+
+Generates a C file of about SIZE MB (default 50) with gen_corpus.py, minifies
+it once with --stats and prints the peak RSS of the run next to the input
+size. --stats reports the memory held by the ASTContext, which is clang's and
+not the text pipeline's; what is left over is the input buffer, the renamed
+code and the output, shown as a multiple of the input size.
+"""
+import argparse
+import os
+import re
+import resource
+import subprocess
+import tempfile
+
+from gen_corpus import module, program
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--minic", default="minic")
+    ap.add_argument("--mb", type=float, default=50)
+    opts = ap.parse_args()
+
+    modules = max(1, int(opts.mb * 1e6 / len(module(0))))
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join(tmp, "huge.c")
+        with open(path, "w") as f:
+            f.write(program(modules))
+        size = os.path.getsize(path)
+        run = subprocess.run([opts.minic, "--stats", path], check=True,
+                             stdout=subprocess.DEVNULL, stderr=subprocess.PIPE,
+                             text=True)
+    # ru_maxrss is in KiB on Linux.
+    peak = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss * 1024
+    ast = re.search(r"(\d+) KiB AST", run.stderr)
+    ast = int(ast.group(1)) * 1024 if ast else 0
+    mb = 1 << 20
+    print(f"input        {size / mb:9.1f} MiB")
+    print(f"peak RSS     {peak / mb:9.1f} MiB")
+    print(f"AST          {ast / mb:9.1f} MiB")
+    print(f"rest / input {(peak - ast) / size:9.2f}x")
+
+
+if __name__ == "__main__":
+    main()
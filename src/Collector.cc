@@ -1,34 +1,60 @@
 #include "Collector.h"
 
+/*
+ * Walk the block by hand so that VisitVarDecl knows whether the DeclStmt it
+ * sits in is a direct child of a block, and of which one, without asking the
+ * ParentMap (which is built for the whole AST, headers included).
+ */
+bool Collector::TraverseCompoundStmt(CompoundStmt *cs) {
+  if (!WalkUpFromCompoundStmt(cs))
+    return false;
+  const CompoundStmt *outer = declScope;
+  for (Stmt *s : cs->body()) {
+    declScope = isa<DeclStmt>(s) ? cs : nullptr;
+    if (!TraverseStmt(s))
+      return false;
+  }
+  declScope = outer;
+  return true;
+}
+
 bool Collector::VisitFunctionDecl(FunctionDecl *fd) {
   if (fd->isOverloadedOperator() || !fd->getIdentifier())
     return true;
-  used.insert(CachedHashStringRef(fd->getName()));
-  if (!fd->isDefined())
+  if (!fd->isDefined()) {
+    // A prototype seen before its definition; its parameters are renamed
+    // along with the definition's once that has been parsed.
+    if (sm.isWrittenInMainFile(fd->getLocation()))
+      undefined.push_back(fd);
     return true;
-  std::string name = fd->getNameAsString();
+  }
+  StringRef name = fd->getName();
   if (sm.isWrittenInMainFile(fd->getLocation())) {
-    if (!is_contained(ignores, name))
+    if (!is_contained(mc.ignores, name))
 #ifndef NDEBUG
-      errs() << "in VisitFunctionDecl, typeid: "
-             << typeid(fd->getCanonicalDecl()).name() << "\n",
+      errs() << "in VisitFunctionDecl: " << name << "\n",
 #endif
-          d2name[fd->getCanonicalDecl()].type_hash =
-              typeid(fd->getCanonicalDecl()).hash_code();
+          mc.symbols.get(fd->getCanonicalDecl(), SymbolKind::Function);
     for (ParmVarDecl *param : fd->parameters())
       VisitVarDecl(param);
   }
   return true;
 }
 
+void Collector::finish() {
+  for (FunctionDecl *fd : undefined)
+    if (fd->isDefined())
+      VisitFunctionDecl(fd);
+  undefined.clear();
+}
+
 bool Collector::VisitVarDecl(VarDecl *vd) {
   if (!vd->getIdentifier())
     return true;
-  used.insert(CachedHashStringRef(vd->getName()));
   auto kind = vd->isThisDeclarationADefinition();
   if (kind != VarDecl::Definition || !sm.isWrittenInMainFile(vd->getLocation()))
     return true;
-  /* If it's an local variable, lookup its parent twice.
+  /* If it's an local variable, find the block its DeclStmt belongs to.
    * Function block level variable AST Chain:
    * FunctionDecl-->CompoundStmt-->DeclStmt-->VarDecl
    * example:
@@ -46,16 +72,12 @@ bool Collector::VisitVarDecl(VarDecl *vd) {
    *   }
    * }
    *
-   * We insert its grandparent (CompoundStmt) into the bidirectional map.
+   * We insert its grandparent (CompoundStmt, tracked as declScope by
+   * TraverseCompoundStmt) into the bidirectional map.
    */
   if (vd->isLocalVarDecl()) {
-    const DeclStmt *ds = getParent<DeclStmt, VarDecl>(*vd);
-    if (ds) {
-      const CompoundStmt *cs = getParent<CompoundStmt, DeclStmt>(*ds);
-      if (cs) {
-        d2name[vd->getCanonicalDecl()].c = cs;
-        c2d[cs].d.push_back(vd->getCanonicalDecl());
-      }
+    if (const CompoundStmt *cs = declScope) {
+      mc.symbols.get(vd->getCanonicalDecl(), SymbolKind::Variable).scope = cs;
     }
     /*
      * For the ParmVar, the structure looks like this:
@@ -75,55 +97,53 @@ bool Collector::VisitVarDecl(VarDecl *vd) {
       // fd->dumpColor();
       if (const CompoundStmt *cs =
               static_cast<const CompoundStmt *>(fd->getBody())) {
-        d2name[vd->getCanonicalDecl()].c = cs;
-        c2d[cs].d.push_back(vd->getCanonicalDecl());
+        mc.symbols.get(vd->getCanonicalDecl(), SymbolKind::Variable).scope =
+            cs;
       }
     }
   }
 #ifndef NDEBUG
-  errs() << "in VisitVarDecl, typeid: " << typeid(vd->getCanonicalDecl()).name()
-         << "\n",
+  errs() << "in VisitVarDecl: " << vd->getName() << "\n",
 #endif
-      d2name[vd->getCanonicalDecl()].type_hash =
-          typeid(vd->getCanonicalDecl()).hash_code();
+      mc.symbols.get(vd->getCanonicalDecl(), SymbolKind::Variable);
   return true;
 }
 
 bool Collector::VisitFieldDecl(FieldDecl *fd) {
-  used.insert(CachedHashStringRef(fd->getName()));
   if (!sm.isWrittenInMainFile(fd->getLocation()))
     return true;
 #ifndef NDEBUG
-  errs() << "in VisitFieldDecl, typeid: "
-         << typeid(fd->getCanonicalDecl()).name() << "\n",
+  errs() << "in VisitFieldDecl: " << fd->getName() << "\n",
 #endif
-      d2name[fd->getCanonicalDecl()].type_hash =
-          typeid(fd->getCanonicalDecl()).hash_code();
+      mc.symbols.get(fd->getCanonicalDecl(), SymbolKind::Field);
   return true;
 }
 
 bool Collector::VisitTypeDecl(TypeDecl *td) {
-  used.insert(CachedHashStringRef(td->getName()));
   if (!sm.isWrittenInMainFile(td->getLocation()))
     return true;
 #ifndef NDEBUG
-  errs() << "in VisitTypeDecl, typeid: " << typeid(td).name() << "\n",
+  errs() << "in VisitTypeDecl: " << td->getName() << "\n",
 #endif
-      // TypeDecl does not have its own getCanonicalDecl method, so calling
-      // td->getCanonicalDecl() would get its base class (Decl *)this and is
-      // certainly of no use.
-      d2name[td->getCanonicalDecl()].type_hash = typeid(td).hash_code();
+      mc.symbols.get(td->getCanonicalDecl(), SymbolKind::Type);
   return true;
 }
 
 bool Collector::VisitEnumConstantDecl(EnumConstantDecl *ecd) {
-  used.insert(CachedHashStringRef(ecd->getName()));
   if (!sm.isWrittenInMainFile(ecd->getLocation()))
     return true;
 #ifndef NDEBUG
-  errs() << "in VisitEnumConstantDecl, typeid: " << typeid(ecd).name() << "\n",
+  errs() << "in VisitEnumConstantDecl: " << ecd->getName() << "\n",
 #endif
-      d2name[ecd->getCanonicalDecl()].type_hash =
-          typeid(ecd->getCanonicalDecl()).hash_code();
+      mc.symbols.get(ecd->getCanonicalDecl(), SymbolKind::EnumConstant);
+  return true;
+}
+
+// Finding the call operator of a lambda builds the lookup table of its
+// closure type, which Renamers on several threads must not do at once.
+bool Collector::VisitLambdaExpr(LambdaExpr *e) {
+  e->getCallOperator();
+  if (e->getLambdaClass()->isDependentContext())
+    mc.lambdaInTemplate = true;
   return true;
 }
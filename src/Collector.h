@@ -1,23 +1,25 @@
 #pragma once
 
-#include "common.h"
-
-extern SmallVector<StringRef, 0> ignores;
-extern MapVector<Decl *, DeclMapData> d2name;
-extern MapVector<const CompoundStmt *, CompoundStmtMapData> c2d;
-extern DenseSet<CachedHashStringRef> used;
+#include "Context.h"
 
 struct Collector : RecursiveASTVisitor<Collector> {
   SourceManager &sm;
   ASTContext &ctx;
+  MiniContext &mc;
+  // The CompoundStmt whose direct child DeclStmt is being traversed, if any.
+  const CompoundStmt *declScope = nullptr;
+  // Functions of the main file not defined when they were traversed; those
+  // defined by the end of the TU are visited again by finish().
+  std::vector<FunctionDecl *> undefined;
 
-  Collector(ASTContext &ctx) : sm(ctx.getSourceManager()), ctx{ctx} {};
-  template <typename T1, typename T2> const T1 *getParent(const T2 &n) {
-    return ::getParent<T1, T2>(ctx, n);
-  }
+  Collector(ASTContext &ctx, MiniContext &mc)
+      : sm(ctx.getSourceManager()), ctx{ctx}, mc{mc} {};
+  bool TraverseCompoundStmt(CompoundStmt *cs);
   bool VisitFunctionDecl(FunctionDecl *fd);
   bool VisitVarDecl(VarDecl *vd);
   bool VisitFieldDecl(FieldDecl *fd);
   bool VisitTypeDecl(TypeDecl *td);
   bool VisitEnumConstantDecl(EnumConstantDecl *ecd);
+  bool VisitLambdaExpr(LambdaExpr *e);
+  void finish();
 };
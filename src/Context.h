@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+
+#include "Symbols.h"
+#include "common.h"
+#include "minic.h"
+
+/*
+ * Adds the wall time between its construction and destruction to *slot,
+ * unless slot is null, and shows up as a span named name in --time-trace
+ * output. Spans must nest, so pass a null name for a phase that ends inside
+ * clang's own spans.
+ */
+struct PhaseTimer {
+  double *slot;
+  std::optional<TimeTraceScope> scope;
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+
+  PhaseTimer(const char *name, double *slot) : slot(slot) {
+    if (name)
+      scope.emplace(name);
+  }
+  ~PhaseTimer() {
+    if (slot)
+      *slot += std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                             start)
+                   .count();
+  }
+};
+
+/*
+ * Everything one translation unit needs while being minified. Each
+ * CompilerInstance gets its own MiniContext, so several TUs can be processed
+ * at the same time.
+ */
+struct MiniContext {
+  // Function names that must keep their names; shared and read-only.
+  ArrayRef<StringRef> ignores;
+  // Backs the new names; released in one go with the context.
+  BumpPtrAllocator alloc;
+  StringSaver saver{alloc};
+  SymbolTable symbols;
+  ReservedNames reserved;
+  std::string newCode;
+  unsigned threads = 1;
+  bool pruneIncludes = false, stripDead = false;
+  // Set by the Collector: a lambda in a template, whose instantiations have
+  // closure types only built at the end of the TU.
+  bool lambdaInTemplate = false;
+  std::vector<std::string> *prunedIncludes = nullptr;
+  minic::Timings *timings = nullptr;
+  minic::Stats *stats = nullptr;
+  // Runs from BeginSourceFile until the consumer sees the whole TU.
+  std::optional<PhaseTimer> parsing;
+
+  double *phase(double minic::Timings::*p) {
+    return timings ? &(timings->*p) : nullptr;
+  }
+};
@@ -0,0 +1,280 @@
+#include "DeadDecls.h"
+
+namespace {
+// Collects the decls a top-level decl refers to, as written and in its
+// instantiations, and the symbols its attributes name as strings.
+struct References : RecursiveASTVisitor<References> {
+  std::vector<const Decl *> &refs;
+  std::vector<StringRef> &symbols;
+
+  References(std::vector<const Decl *> &refs, std::vector<StringRef> &symbols)
+      : refs(refs), symbols(symbols) {}
+  bool shouldVisitTemplateInstantiations() const { return true; }
+  bool shouldVisitImplicitCode() const { return true; }
+
+  void use(const Decl *d) {
+    if (d)
+      refs.push_back(d);
+  }
+  void useType(QualType t) {
+    if (t.isNull())
+      return;
+    const Type *ty = t->getPointeeOrArrayElementType();
+    if (auto *tt = ty->getAs<TypedefType>())
+      use(tt->getDecl());
+    use(ty->getAsTagDecl());
+  }
+
+  bool VisitDeclRefExpr(DeclRefExpr *e) {
+    use(e->getDecl());
+    return true;
+  }
+  bool VisitMemberExpr(MemberExpr *e) {
+    use(e->getMemberDecl());
+    return true;
+  }
+  // Every candidate of an unresolved call, since any may be the one picked.
+  bool VisitOverloadExpr(OverloadExpr *e) {
+    for (NamedDecl *d : e->decls())
+      use(d);
+    return true;
+  }
+  bool VisitCXXConstructExpr(CXXConstructExpr *e) {
+    use(e->getConstructor());
+    return true;
+  }
+  bool VisitExpr(Expr *e) {
+    useType(e->getType());
+    return true;
+  }
+  bool VisitTypeLoc(TypeLoc tl) {
+    useType(tl.getType());
+    return true;
+  }
+  // cleanup(f) names a function; alias("f") and the like, a symbol.
+  bool VisitDecl(Decl *d) {
+    for (const Attr *a : d->attrs())
+      if (auto *cleanup = dyn_cast<CleanupAttr>(a))
+        use(cleanup->getFunctionDecl());
+      else if (auto *alias = dyn_cast<AliasAttr>(a))
+        symbols.push_back(alias->getAliasee());
+      else if (auto *ifunc = dyn_cast<IFuncAttr>(a))
+        symbols.push_back(ifunc->getResolver());
+      else if (auto *weakref = dyn_cast<WeakRefAttr>(a))
+        symbols.push_back(weakref->getAliasee());
+    return true;
+  }
+};
+} // namespace
+
+// The top-level decl d is part of (a field's struct, a local's function), by
+// its first declaration.
+static const Decl *topLevelOf(const Decl *d) {
+  d = d->getCanonicalDecl();
+  while (!d->getDeclContext()->getRedeclContext()->isFileContext())
+    d = Decl::castFromDeclContext(d->getDeclContext())->getCanonicalDecl();
+  return d;
+}
+
+// Whether C++ could call fd without naming it: an operator, or a function
+// that argument-dependent lookup may find from a template of some header.
+static bool mayBeFoundByADL(const FunctionDecl *fd) {
+  if (fd->isOverloadedOperator())
+    return true;
+  return llvm::any_of(fd->parameters(), [](const ParmVarDecl *p) {
+    QualType t = p->getType().getNonReferenceType();
+    return t->getPointeeOrArrayElementType()->getAsTagDecl() != nullptr;
+  });
+}
+
+// Whether d may go when nothing refers to it: an internal function or
+// variable (whose initialization has no side effects), a typedef or a tag.
+static bool isRemovable(ASTContext &ctx, const Decl *d,
+                        ArrayRef<StringRef> ignores) {
+  if (d->isImplicit() || d->isTemplated() ||
+      llvm::any_of(d->attrs(), [](const Attr *a) { return !a->isImplicit(); }))
+    return false;
+  if (auto *fd = dyn_cast<FunctionDecl>(d))
+    return !isa<CXXMethodDecl>(fd) && !fd->isExternallyVisible() &&
+           fd->getTemplateSpecializationKind() == TSK_Undeclared &&
+           !(fd->getIdentifier() && is_contained(ignores, fd->getName())) &&
+           !(ctx.getLangOpts().CPlusPlus && mayBeFoundByADL(fd));
+  if (auto *vd = dyn_cast<VarDecl>(d)) {
+    if (vd->isExternallyVisible() || isa<VarTemplateSpecializationDecl>(vd) ||
+        vd->needsDestruction(ctx))
+      return false;
+    const Expr *init = vd->getInit();
+    return !init ||
+           init->isConstantInitializer(ctx, vd->getType()->isReferenceType());
+  }
+  if (isa<TypedefNameDecl>(d))
+    return true;
+  return isa<TagDecl>(d) && !isa<ClassTemplateSpecializationDecl>(d);
+}
+
+namespace {
+// Top-level decls that share source (struct S {...} s, t;), which can only
+// be deleted together, as code[from, to).
+struct Group {
+  size_t first, last;
+  unsigned from, to;
+  // Whether the source can be cut out at all.
+  bool deletable;
+};
+} // namespace
+
+static std::vector<Group> groupDecls(ASTContext &ctx,
+                                     ArrayRef<Decl *> topLevel) {
+  const SourceManager &sm = ctx.getSourceManager();
+  const LangOptions &lo = ctx.getLangOpts();
+  StringRef code = sm.getBufferData(sm.getMainFileID());
+  auto begin = [&](const Decl *d) {
+    return sm.getFileOffset(sm.getExpansionLoc(d->getBeginLoc()));
+  };
+  auto end = [&](const Decl *d) {
+    return sm.getFileOffset(sm.getExpansionRange(d->getEndLoc()).getEnd());
+  };
+  std::vector<Group> groups;
+  for (size_t i = 0, j; i != topLevel.size(); i = j) {
+    // last ends the furthest. In static struct S {...} s, s starts first.
+    const Decl *last = topLevel[i];
+    Group g{i, i, begin(last), 0, true};
+    for (j = i; j != topLevel.size() && begin(topLevel[j]) <= end(last); j++) {
+      const Decl *d = topLevel[j];
+      g.from = std::min(g.from, begin(d));
+      if (end(d) > end(last))
+        last = d;
+      g.deletable = g.deletable && d->getBeginLoc().isFileID() &&
+                    d->getEndLoc().isFileID();
+    }
+    g.last = j - 1;
+
+    // A definition ends at its }, anything else at the ; after it.
+    SourceLocation stop;
+    auto *fd = dyn_cast<FunctionDecl>(last);
+    if (g.deletable && fd && fd->doesThisDeclarationHaveABody())
+      stop = Lexer::getLocForEndOfToken(last->getEndLoc(), 0, sm, lo);
+    else if (g.deletable)
+      stop = Lexer::findLocationAfterToken(last->getEndLoc(), tok::semi, sm,
+                                           lo, false);
+    g.deletable = stop.isValid();
+    if (g.deletable) {
+      g.to = sm.getFileOffset(stop);
+      // Directives inside, even in a function body, may matter past it.
+      SmallVector<StringRef, 16> lines;
+      code.slice(g.from, g.to).split(lines, '\n');
+      g.deletable = llvm::none_of(lines, [](StringRef line) {
+        line = line.ltrim(" \t");
+        return !line.empty() && line[0] == '#';
+      });
+    }
+    groups.push_back(g);
+  }
+  return groups;
+}
+
+unsigned findDeadDecls(ASTContext &ctx, ArrayRef<Decl *> topLevel,
+                       ArrayRef<StringRef> ignores,
+                       std::vector<Deletion> &deletions) {
+  std::vector<Group> groups = groupDecls(ctx, topLevel);
+  // Whether each top-level decl, with all its redeclarations, may go.
+  DenseSet<const Decl *> written(topLevel.begin(), topLevel.end());
+  DenseMap<const Decl *, bool> removable;
+  for (const Group &g : groups)
+    for (const Decl *d : topLevel.slice(g.first, g.last - g.first + 1)) {
+      auto [it, inserted] = removable.try_emplace(topLevelOf(d), true);
+      it->second = it->second && g.deletable && isRemovable(ctx, d, ignores);
+    }
+  for (auto &[d, ok] : removable)
+    if (ok)
+      ok = llvm::all_of(d->redecls(),
+                        [&](const Decl *r) { return written.contains(r); });
+
+  // The symbol names of the functions and variables that may go, for the
+  // attributes that refer to them as strings.
+  StringMap<const Decl *> bySymbol;
+  std::unique_ptr<MangleContext> mangler(ctx.createMangleContext());
+  for (auto &[d, ok] : removable) {
+    if (!ok || !isa<FunctionDecl, VarDecl>(d))
+      continue;
+    auto *nd = cast<NamedDecl>(d);
+    if (mangler->shouldMangleDeclName(nd)) {
+      std::string name;
+      raw_string_ostream os(name);
+      if (auto *fd = dyn_cast<FunctionDecl>(nd))
+        mangler->mangleName(GlobalDecl(fd), os);
+      else
+        mangler->mangleName(GlobalDecl(cast<VarDecl>(nd)), os);
+      bySymbol[os.str()] = d;
+    } else if (nd->getIdentifier())
+      bySymbol[nd->getName()] = d;
+  }
+  // Appends the decls that may go which d refers to to out.
+  std::vector<const Decl *> refs;
+  std::vector<StringRef> symbols;
+  auto referred = [&](Decl *d, std::vector<const Decl *> &out) {
+    refs.clear();
+    symbols.clear();
+    References(refs, symbols).TraverseDecl(d);
+    for (StringRef name : symbols)
+      if (const Decl *k = bySymbol.lookup(name))
+        out.push_back(k);
+    for (const Decl *r : refs)
+      if (const Decl *k = topLevelOf(r); removable.count(k))
+        out.push_back(k);
+  };
+  DenseMap<const Decl *, std::vector<const Decl *>> uses;
+  for (Decl *d : topLevel)
+    referred(d, uses[topLevelOf(d)]);
+  // Headers may use the main file's decls too, as a single-file library
+  // does with the allocator its user defines before including it. Whatever
+  // a decl outside the main file refers to stays. Only the decls after the
+  // main file's first one can; those before it, a whole precompiled preamble
+  // among them, are neither walked nor loaded.
+  std::vector<const Decl *> outside;
+  bool after = false;
+  for (Decl *d : ctx.getTranslationUnitDecl()->noload_decls())
+    if (written.contains(d))
+      after = true;
+    else if (after)
+      referred(d, outside);
+
+  // Everything a live decl uses is live. A group that keeps one live decl
+  // keeps them all, and with them what they use.
+  DenseSet<const Decl *> live;
+  std::vector<const Decl *> work;
+  auto reach = [&](const Decl *d) {
+    if (live.insert(d).second)
+      work.push_back(d);
+  };
+  for (auto &[d, ok] : removable)
+    if (!ok)
+      reach(d);
+  for (const Decl *d : outside)
+    reach(d);
+  while (!work.empty()) {
+    while (!work.empty()) {
+      const Decl *d = work.back();
+      work.pop_back();
+      if (auto it = uses.find(d); it != uses.end())
+        for (const Decl *k : it->second)
+          reach(k);
+    }
+    for (const Group &g : groups) {
+      ArrayRef<Decl *> decls = topLevel.slice(g.first, g.last - g.first + 1);
+      if (llvm::any_of(decls, [&](const Decl *d) {
+            return live.contains(topLevelOf(d));
+          }))
+        for (const Decl *d : decls)
+          reach(topLevelOf(d));
+    }
+  }
+
+  unsigned removed = 0;
+  for (const Group &g : groups)
+    if (!live.contains(topLevelOf(topLevel[g.first]))) {
+      deletions.push_back({g.from, g.to});
+      removed += g.last - g.first + 1;
+    }
+  return removed;
+}
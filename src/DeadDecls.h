@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Context.h"
+#include "Renamer.h"
+
+/*
+ * Find the top-level decls of the main file that nothing can reach, and
+ * append the source ranges to delete to deletions, in order. The roots are
+ * every decl with external linkage (main among them), the functions in
+ * ignores, every decl not of a kind that can go and whatever the headers
+ * included after the main file's first decl refer to: only internal
+ * functions and variables, typedefs and tags are removed, along with all
+ * their redeclarations. A decl also reaches what its attributes name
+ * (cleanup(f), alias("f")).
+ * Decls that share a declaration (struct S {...} s, t;) go only together.
+ * Returns the number of decls removed.
+ */
+unsigned findDeadDecls(ASTContext &ctx, ArrayRef<Decl *> topLevel,
+                       ArrayRef<StringRef> ignores,
+                       std::vector<Deletion> &deletions);
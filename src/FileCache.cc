@@ -0,0 +1,120 @@
+#include "FileCache.h"
+
+namespace {
+// A read-only view of a buffer owned by the FileCache.
+struct CachedFile : vfs::File {
+  vfs::Status st;
+  MemoryBufferRef buf;
+
+  CachedFile(vfs::Status st, MemoryBufferRef buf)
+      : st(std::move(st)), buf(buf) {}
+  ErrorOr<vfs::Status> status() override { return st; }
+  ErrorOr<std::unique_ptr<MemoryBuffer>>
+  getBuffer(const Twine &name, int64_t fileSize, bool requiresNullTerminator,
+            bool isVolatile) override {
+    return MemoryBuffer::getMemBuffer(buf, requiresNullTerminator);
+  }
+  std::error_code close() override { return {}; }
+};
+
+struct CachingFileSystem : vfs::ProxyFileSystem {
+  FileCache &cache;
+
+  CachingFileSystem(FileCache &cache, IntrusiveRefCntPtr<vfs::FileSystem> base)
+      : ProxyFileSystem(std::move(base)), cache(cache) {}
+  ErrorOr<vfs::Status> status(const Twine &path) override {
+    SmallString<256> buf;
+    return cache.status(getUnderlyingFS(), path.toStringRef(buf));
+  }
+  ErrorOr<std::unique_ptr<vfs::File>>
+  openFileForRead(const Twine &path) override {
+    SmallString<256> buf;
+    return cache.open(getUnderlyingFS(), path.toStringRef(buf));
+  }
+};
+} // namespace
+
+// Whether two stats of a path are of the same file, unchanged.
+static bool sameFile(const ErrorOr<vfs::Status> &a,
+                     const ErrorOr<vfs::Status> &b) {
+  if (!a || !b)
+    return bool(a) == bool(b);
+  return a->getSize() == b->getSize() &&
+         a->getLastModificationTime() == b->getLastModificationTime() &&
+         a->getUniqueID() == b->getUniqueID();
+}
+
+ErrorOr<vfs::Status> FileCache::status(vfs::FileSystem &fs, StringRef path) {
+  Shard &shard = shardFor(path);
+  {
+    std::lock_guard<std::mutex> lock(shard.mu);
+    if (auto it = shard.stats.find(path);
+        it != shard.stats.end() && it->second.checked == generation)
+      return it->second.st;
+  }
+  // Misses are the common case during header search; cache them too.
+  ErrorOr<vfs::Status> st = fs.status(path);
+  std::lock_guard<std::mutex> lock(shard.mu);
+  auto [it, inserted] = shard.stats.try_emplace(path, Stat{st, generation});
+  if (!inserted && it->second.checked != generation) {
+    if (!sameFile(st, it->second.st))
+      shard.contents.erase(path);
+    it->second = {st, generation};
+  }
+  return it->second.st;
+}
+
+ErrorOr<std::unique_ptr<vfs::File>> FileCache::open(vfs::FileSystem &fs,
+                                                     StringRef path) {
+  if (uncached.contains(path))
+    return fs.openFileForRead(path);
+  Shard &shard = shardFor(path);
+  // The cached file, if its contents are kept and its stat is current.
+  bool stale = false;
+  auto hit = [&]() -> std::unique_ptr<vfs::File> {
+    std::lock_guard<std::mutex> lock(shard.mu);
+    auto st = shard.stats.find(path);
+    if (st == shard.stats.end())
+      return nullptr;
+    stale = st->second.checked != generation;
+    auto it = shard.contents.find(path);
+    if (stale || !st->second.st || it == shard.contents.end())
+      return nullptr;
+    return std::make_unique<CachedFile>(
+        vfs::Status::copyWithNewName(*st->second.st, path),
+        it->second->getMemBufferRef());
+  };
+  if (auto file = hit())
+    return file;
+  // A stale stat is checked first, which drops the contents if they changed.
+  if (stale) {
+    status(fs, path);
+    if (auto file = hit())
+      return file;
+  }
+
+  auto file = fs.openFileForRead(path);
+  if (!file)
+    return file;
+  auto st = (*file)->status();
+  if (!st)
+    return file;
+  auto buf = (*file)->getBuffer(path, st->getSize(), true, false);
+  if (!buf)
+    return buf.getError();
+
+  std::lock_guard<std::mutex> lock(shard.mu);
+  shard.stats.insert_or_assign(path, Stat{*st, generation});
+  // Another worker may have raced us here; either copy is fine.
+  auto &slot = shard.contents[path];
+  if (!slot)
+    slot = std::move(*buf);
+  return std::make_unique<CachedFile>(vfs::Status::copyWithNewName(*st, path),
+                                      slot->getMemBufferRef());
+}
+
+IntrusiveRefCntPtr<vfs::FileSystem>
+createCachingFileSystem(FileCache &cache,
+                        IntrusiveRefCntPtr<vfs::FileSystem> base) {
+  return makeIntrusiveRefCnt<CachingFileSystem>(cache, std::move(base));
+}
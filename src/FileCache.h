@@ -0,0 +1,50 @@
+#pragma once
+
+#include "common.h"
+
+/*
+ * Stat results and file contents shared by every worker of a batch run.
+ * Each CompilerInstance still owns its FileManager, but they all sit on a
+ * CachingFileSystem backed by one FileCache, so a header is stat'ed and read
+ * once per process instead of once per TU. Sharded to keep lock contention
+ * low with many workers.
+ */
+class FileCache {
+  // A stat result, and the generation it was last checked in.
+  struct Stat {
+    ErrorOr<vfs::Status> st;
+    unsigned checked;
+  };
+  struct Shard {
+    std::mutex mu;
+    StringMap<Stat> stats;
+    StringMap<std::unique_ptr<MemoryBuffer>> contents;
+  };
+  Shard shards[32];
+  // Files read exactly once (the inputs themselves); never worth keeping.
+  StringSet<> uncached;
+  unsigned generation = 0;
+
+  Shard &shardFor(StringRef path) {
+    return shards[hash_value(path) % std::size(shards)];
+  }
+
+public:
+  // Must be called before any worker starts.
+  void addUncached(StringRef path) { uncached.insert(path); }
+  /* Make every cached stat stale. A path asked for again is stat'ed once
+   * more, and its contents are forgotten if the result changed (created,
+   * deleted, or a new size, mtime or inode); paths not asked for cost
+   * nothing. For a long-lived cache, between uses: no file opened through
+   * the cache may still be in use.
+   */
+  void expire() { generation++; }
+
+  ErrorOr<vfs::Status> status(vfs::FileSystem &fs, StringRef path);
+  ErrorOr<std::unique_ptr<vfs::File>> open(vfs::FileSystem &fs,
+                                           StringRef path);
+};
+
+IntrusiveRefCntPtr<vfs::FileSystem>
+createCachingFileSystem(FileCache &cache,
+                        IntrusiveRefCntPtr<vfs::FileSystem> base);
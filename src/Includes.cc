@@ -0,0 +1,283 @@
+#include "Includes.h"
+
+void IncludeGraph::enter(SourceLocation start) {
+  FileID f = sm.getFileID(start);
+  entered.push_back(f);
+  SourceLocation inc = sm.getIncludeLoc(f);
+  if (inc.isValid() && sm.getFileID(inc) == sm.getMainFileID())
+    includes.push_back(f);
+}
+
+FileID IncludeGraph::top(SourceLocation loc) {
+  if (loc.isInvalid())
+    return FileID();
+  FileID f = sm.getFileID(sm.getExpansionLoc(loc));
+  auto [it, inserted] = tops.try_emplace(f);
+  if (!inserted)
+    return it->second;
+  FileID main = sm.getMainFileID();
+  it->second = main;
+  for (FileID cur = f; cur != main;) {
+    SourceLocation inc = sm.getIncludeLoc(cur);
+    if (inc.isInvalid())
+      break;
+    FileID parent = sm.getFileID(inc);
+    if (parent == main)
+      it->second = cur;
+    cur = parent;
+  }
+  return it->second;
+}
+
+std::vector<FileID> IncludeGraph::unused() {
+  DenseSet<FileID> reached{sm.getMainFileID()};
+  std::vector<FileID> work{sm.getMainFileID()};
+  while (!work.empty()) {
+    auto it = needs.find(work.back());
+    work.pop_back();
+    if (it != needs.end())
+      for (FileID def : it->second)
+        if (reached.insert(def).second)
+          work.push_back(def);
+  }
+  std::vector<FileID> res;
+  for (FileID f : includes)
+    if (!reached.contains(f))
+      res.push_back(f);
+  return res;
+}
+
+uint64_t IncludeGraph::bytesUnder(ArrayRef<FileID> includes) {
+  DenseSet<FileID> set(includes.begin(), includes.end());
+  uint64_t bytes = 0;
+  for (FileID f : entered)
+    if (set.contains(top(sm.getLocForStartOfFile(f))))
+      bytes += sm.getFileIDSize(f);
+  return bytes;
+}
+
+namespace {
+// A macro is used where it is expanded or tested, by the include holding
+// that line; for a macro expanded inside another, that is where the outer
+// one was expanded. A name tested while undefined uses the last #undef of
+// it, and an #undef of another file's macro is needed by everything after
+// it, where the name no longer expands.
+struct IncludeCallbacks : PPCallbacks {
+  IncludeGraph &g;
+  DenseMap<const IdentifierInfo *, SourceLocation> undefs;
+
+  IncludeCallbacks(IncludeGraph &g) : g(g) {}
+  void use(const Token &name, const MacroDefinition &md) {
+    if (MacroInfo *mi = md.getMacroInfo())
+      g.use(name.getLocation(), mi->getDefinitionLoc());
+    else if (auto it = undefs.find(name.getIdentifierInfo());
+             it != undefs.end())
+      g.use(name.getLocation(), it->second);
+  }
+  void FileChanged(SourceLocation loc, FileChangeReason reason,
+                   SrcMgr::CharacteristicKind, FileID) override {
+    if (reason == EnterFile)
+      g.enter(loc);
+  }
+  void MacroExpands(const Token &name, const MacroDefinition &md, SourceRange,
+                    const MacroArgs *) override {
+    use(name, md);
+  }
+  void Defined(const Token &name, const MacroDefinition &md,
+               SourceRange) override {
+    use(name, md);
+  }
+  void Ifdef(SourceLocation, const Token &name,
+             const MacroDefinition &md) override {
+    use(name, md);
+  }
+  void Ifndef(SourceLocation, const Token &name,
+              const MacroDefinition &md) override {
+    use(name, md);
+  }
+  void MacroUndefined(const Token &name, const MacroDefinition &md,
+                      const MacroDirective *) override {
+    MacroInfo *mi = md.getMacroInfo();
+    if (!mi)
+      return;
+    SourceLocation loc = name.getLocation();
+    undefs[name.getIdentifierInfo()] = loc;
+    if (g.top(loc) != g.top(mi->getDefinitionLoc()))
+      g.use(FileID(), g.top(loc));
+  }
+};
+
+/*
+ * Each decl at file scope (or in a namespace) is owned by the include it is
+ * in, and everything it refers to, from the types it is written with to the
+ * definitions of what its body calls, is used by that include. So is
+ * whatever lies inside it but comes from another file: the lines of an
+ * #include in the middle of a function or an initializer. Instantiations and
+ * implicit code are visited too, as they can refer to decls that nothing
+ * written does.
+ */
+struct DeclUses : RecursiveASTVisitor<DeclUses> {
+  ASTContext &ctx;
+  IncludeGraph &g;
+  FileID owner;
+
+  DeclUses(ASTContext &ctx, IncludeGraph &g) : ctx(ctx), g(g) {}
+  bool shouldVisitTemplateInstantiations() const { return true; }
+  bool shouldVisitImplicitCode() const { return true; }
+
+  void useDecl(const Decl *d) {
+    if (!d)
+      return;
+    g.use(owner, g.top(d->getLocation()));
+    // A definition in a header is not seen through the declarations of the
+    // main file: static inline functions, tags completed in a header.
+    const Decl *def = nullptr;
+    if (auto *fd = dyn_cast<FunctionDecl>(d))
+      def = fd->getDefinition();
+    else if (auto *vd = dyn_cast<VarDecl>(d))
+      def = vd->getDefinition();
+    else if (auto *td = dyn_cast<TagDecl>(d))
+      def = td->getDefinition();
+    if (def && def != d)
+      g.use(owner, g.top(def->getLocation()));
+  }
+  void useType(QualType t) {
+    if (t.isNull())
+      return;
+    const Type *ty = t->getPointeeOrArrayElementType();
+    if (auto *tt = ty->getAs<TypedefType>())
+      useDecl(tt->getDecl());
+    if (auto *tst = ty->getAs<TemplateSpecializationType>())
+      useDecl(tst->getTemplateName().getAsTemplateDecl());
+    useDecl(ty->getAsTagDecl());
+  }
+  // Definitions another TU or the program's startup may need, whether or
+  // not this TU refers to them.
+  bool isRoot(Decl *d) {
+    if (isa<FileScopeAsmDecl>(d) || d->hasAttr<UsedAttr>() ||
+        d->hasAttr<ConstructorAttr>() || d->hasAttr<DestructorAttr>())
+      return true;
+    if (auto *fd = dyn_cast<FunctionDecl>(d))
+      return fd->isThisDeclarationADefinition() && fd->isExternallyVisible() &&
+             !fd->isInlined() && !fd->isTemplated() &&
+             fd->getTemplateSpecializationKind() != TSK_ImplicitInstantiation;
+    if (auto *vd = dyn_cast<VarDecl>(d)) {
+      if (vd->isThisDeclarationADefinition() != VarDecl::Definition ||
+          vd->isTemplated() || !vd->hasGlobalStorage())
+        return false;
+      if (vd->isExternallyVisible() && !vd->isInline())
+        return true;
+      // Initialized at startup, which may have side effects.
+      const Expr *init = vd->getInit();
+      return init && !init->isConstantInitializer(
+                         ctx, vd->getType()->isReferenceType());
+    }
+    return false;
+  }
+
+  bool TraverseDecl(Decl *d) {
+    if (!d)
+      return true;
+    FileID outer = owner;
+    if (isa<TranslationUnitDecl, NamespaceDecl, LinkageSpecDecl>(d)) {
+      // Spread over many files; owns nothing itself.
+    } else if (d->getDeclContext()->getRedeclContext()->isFileContext()) {
+      owner = g.top(d->getLocation());
+      if (isRoot(d))
+        g.use(FileID(), owner);
+    } else
+      g.use(owner, g.top(d->getLocation()));
+    bool ok = RecursiveASTVisitor::TraverseDecl(d);
+    owner = outer;
+    return ok;
+  }
+  bool VisitStmt(Stmt *s) {
+    g.use(owner, g.top(s->getBeginLoc()));
+    return true;
+  }
+  bool VisitExpr(Expr *e) {
+    useType(e->getType());
+    return true;
+  }
+  bool VisitDeclRefExpr(DeclRefExpr *e) {
+    useDecl(e->getDecl());
+    useDecl(e->getFoundDecl());
+    return true;
+  }
+  bool VisitMemberExpr(MemberExpr *e) {
+    useDecl(e->getMemberDecl());
+    return true;
+  }
+  bool VisitCXXConstructExpr(CXXConstructExpr *e) {
+    useDecl(e->getConstructor());
+    return true;
+  }
+  bool VisitTypeLoc(TypeLoc tl) {
+    useType(tl.getType());
+    return true;
+  }
+  bool VisitValueDecl(ValueDecl *d) {
+    useType(d->getType());
+    return true;
+  }
+  // A declaration needs the others of its entity, which may give it its
+  // linkage (extern "C", static), its attributes, or in C99 the external
+  // definition of an inline function; an out-of-line definition (void S::f()
+  // {}) needs the one it completes.
+  template <class T> void useRedecls(T *d) {
+    for (T *r : d->redecls())
+      if (r != d)
+        useDecl(r);
+  }
+  bool VisitFunctionDecl(FunctionDecl *d) {
+    useRedecls(d);
+    return true;
+  }
+  bool VisitVarDecl(VarDecl *d) {
+    useRedecls(d);
+    return true;
+  }
+  bool VisitTagDecl(TagDecl *d) {
+    useRedecls(d);
+    return true;
+  }
+  bool VisitUsingDecl(UsingDecl *d) {
+    for (UsingShadowDecl *shadow : d->shadows())
+      useDecl(shadow->getTargetDecl());
+    return true;
+  }
+  bool VisitUsingDirectiveDecl(UsingDirectiveDecl *d) {
+    useDecl(d->getNominatedNamespace());
+    return true;
+  }
+};
+} // namespace
+
+std::unique_ptr<PPCallbacks> makeIncludeCallbacks(IncludeGraph &g) {
+  return std::make_unique<IncludeCallbacks>(g);
+}
+
+void findDeclUses(ASTContext &ctx, IncludeGraph &g) {
+  DeclUses(ctx, g).TraverseDecl(ctx.getTranslationUnitDecl());
+}
+
+bool includeLine(const SourceManager &sm, StringRef code, FileID f,
+                 Deletion &line) {
+  unsigned offset = sm.getFileOffset(sm.getIncludeLoc(f));
+  size_t begin = code.rfind('\n', offset) + 1;
+  // Continuation lines belong to the line they continue.
+  while (begin >= 2 && code[begin - 2] == '\\')
+    begin = code.rfind('\n', begin - 2) + 1;
+  size_t end = code.find('\n', offset);
+  while (end != StringRef::npos && end && code[end - 1] == '\\')
+    end = code.find('\n', end + 1);
+  end = end == StringRef::npos ? code.size() : end + 1;
+
+  // A block comment could run past the line, or have been opened before it.
+  StringRef text = code.slice(begin, end), directive = text.ltrim(" \t");
+  if (directive.empty() || directive[0] != '#' || text.contains("/*") ||
+      text.contains("*/"))
+    return false;
+  line = {unsigned(begin), unsigned(end)};
+  return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Context.h"
+#include "Renamer.h"
+
+/*
+ * Which #include lines of the main file something depends on. Every file
+ * entered belongs to the #include of the main file it was reached through,
+ * and each use of a decl or a macro is an edge from the include the use is
+ * in to the include the decl or macro is in. The main file is the root,
+ * along with the predefines and -include files of the command line. An
+ * include that no path from the root reaches can go, along with the files
+ * it brought in.
+ */
+class IncludeGraph {
+  SourceManager &sm;
+  // The files entered from an #include of the main file, in order, and all
+  // the files entered.
+  std::vector<FileID> includes, entered;
+  DenseMap<FileID, FileID> tops;
+  DenseMap<FileID, DenseSet<FileID>> needs;
+
+public:
+  IncludeGraph(SourceManager &sm) : sm(sm) {}
+
+  // A file was entered; start is its first location.
+  void enter(SourceLocation start);
+  // The file included by the main file that loc was reached through; the
+  // main file for the root, and invalid for an invalid loc.
+  FileID top(SourceLocation loc);
+  // An invalid user is the root; an invalid def is no use.
+  void use(FileID user, FileID def) {
+    if (def.isValid() && def != user)
+      needs[user.isValid() ? user : sm.getMainFileID()].insert(def);
+  }
+  void use(SourceLocation user, SourceLocation def) {
+    use(top(user), top(def));
+  }
+
+  // The includes nothing depends on, in order.
+  std::vector<FileID> unused();
+  // Bytes of the files entered through the includes, an upper bound on what
+  // dropping them takes off the preprocessed output: a file reached through
+  // one of them may be entered again later.
+  uint64_t bytesUnder(ArrayRef<FileID> includes);
+};
+
+// Records the files entered and the macros used (or undefined) into g.
+std::unique_ptr<PPCallbacks> makeIncludeCallbacks(IncludeGraph &g);
+
+// Adds the uses of decls (and the definitions that must stay) in the TU to g.
+void findDeclUses(ASTContext &ctx, IncludeGraph &g);
+
+// The line of code holding the #include that entered f, and its newline.
+// False if the line is not only that directive (with trailing spaces and
+// line comments).
+bool includeLine(const SourceManager &sm, StringRef code, FileID f,
+                 Deletion &line);
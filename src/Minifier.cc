@@ -0,0 +1,632 @@
+#include "Collector.h"
+#include "Context.h"
+#include "DeadDecls.h"
+#include "Includes.h"
+#include "Minifier.h"
+#include "Preamble.h"
+#include "Renamer.h"
+#include "minic.h"
+#include "postProcess.h"
+
+namespace clang {
+std::unique_ptr<CompilerInvocation>
+buildCompilerInvocation(ArrayRef<const char *> args,
+                        IntrusiveRefCntPtr<vfs::FileSystem> fs) {
+  IntrusiveRefCntPtr<DiagnosticsEngine> diags(
+      CompilerInstance::createDiagnostics(new DiagnosticOptions,
+                                          new IgnoringDiagConsumer, true));
+
+  driver::Driver d(args[0], llvm::sys::getDefaultTargetTriple(), *diags,
+                   "minic", fs);
+  d.setCheckInputsExist(false);
+  std::unique_ptr<driver::Compilation> comp(d.BuildCompilation(args));
+  if (!comp)
+    return nullptr;
+  const driver::JobList &jobs = comp->getJobs();
+  if (jobs.size() != 1 || !isa<driver::Command>(*jobs.begin()))
+    return nullptr;
+
+  const driver::Command &cmd = cast<driver::Command>(*jobs.begin());
+  if (StringRef(cmd.getCreator().getName()) != "clang")
+    return nullptr;
+  const llvm::opt::ArgStringList &cc_args = cmd.getArguments();
+  auto ci = std::make_unique<CompilerInvocation>();
+  if (!CompilerInvocation::CreateFromArgs(*ci, cc_args, *diags))
+    return nullptr;
+
+  ci->getDiagnosticOpts().IgnoreWarnings = true;
+  ci->getFrontendOpts().DisableFree = false;
+  // Compilation databases often carry -MD/-MF; never write .d files.
+  ci->getDependencyOutputOpts() = DependencyOutputOptions();
+  return ci;
+}
+
+struct MiniASTConsumer : ASTConsumer {
+  MiniContext &mc;
+  ASTContext *ctx;
+  // Collects each top-level decl of the main file as soon as it is parsed.
+  std::optional<Collector> collector;
+  // Time spent in collector while parsing, which the parse timer also saw.
+  double streamed = 0;
+  int n_fn = 0, n_var = 0, n_fld = 0, n_type = 0, n_enumconst = 0,
+      n_local = 0;
+  // The k-th name for locals, for every colour k handed out so far.
+  std::vector<StringRef> localNames;
+  // Set up by MiniAction with MiniContext::pruneIncludes.
+  std::optional<IncludeGraph> includes;
+  // Ranges of the main file to leave out, in order once collected.
+  std::vector<Deletion> deletions;
+  /* Top-level decls of the main file, in order. Traversing these instead of
+   * the TranslationUnitDecl skips header decls, which with a precompiled
+   * preamble would otherwise all be deserialized just to be ignored.
+   */
+  std::vector<Decl *> topLevel;
+
+  MiniASTConsumer(MiniContext &mc) : mc(mc) {}
+  void Initialize(ASTContext &ctx) override {
+    this->ctx = &ctx;
+    collector.emplace(ctx, mc);
+    // Names of <math.h> functions that some libcs declare unconditionally.
+    for (auto s : {"j0", "j1", "jn", "j0f", "j1f", "jnf", "j0l", "j1l", "jnl"})
+      mc.reserved.insert(s);
+    for (auto s : {"y0", "y1", "yn", "y0f", "y1f", "ynf", "y0l", "y1l", "ynl"})
+      mc.reserved.insert(s);
+  }
+  // The next name from prefix, counting with id, that is not taken.
+  std::string nextName(StringRef prefix, int &id) {
+    static const char digits[] =
+        "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+    for (;; id++) {
+      char letter = prefix[id % prefix.size()];
+      uint64_t number = id / prefix.size();
+      if (mc.reserved.contains(letter, number))
+        continue;
+      std::string newName(1, letter);
+      for (uint64_t i = number; i; i /= 62)
+        newName += digits[i % 62];
+      id++;
+      return newName;
+    }
+  }
+  StringRef getName(StringRef origName, StringRef prefix, int &id) {
+    int old_n = id;
+    std::string newName = nextName(prefix, id);
+    if (newName.size() >= origName.size()) {
+      id = old_n;
+      return mc.saver.save(origName);
+    }
+    return mc.saver.save(newName);
+  }
+  bool HandleTopLevelDecl(DeclGroupRef dgr) override {
+    auto &sm = ctx->getSourceManager();
+    // The span name is null: this runs inside clang's parse spans, and a
+    // span per decl would mostly be under the trace granularity anyway.
+    PhaseTimer t(nullptr, &streamed);
+    for (Decl *d : dgr)
+      if (sm.getFileID(sm.getExpansionLoc(d->getLocation())) ==
+          sm.getMainFileID()) {
+        topLevel.push_back(d);
+        collector->TraverseDecl(d);
+      }
+    return true;
+  }
+  void HandleTranslationUnit(ASTContext &ctx) override {
+    mc.parsing.reset();
+    if (mc.timings) {
+      mc.timings->parse -= streamed;
+      mc.timings->collect += streamed;
+    }
+    collect(ctx);
+    if (includes)
+      pruneIncludes(ctx);
+    if (mc.stripDead)
+      stripDead(ctx);
+    llvm::sort(deletions, [](const Deletion &a, const Deletion &b) {
+      return a.begin < b.begin;
+    });
+    std::vector<Rename> renames;
+    {
+      PhaseTimer t("Rename", mc.phase(&minic::Timings::rename));
+      rename(ctx, renames);
+      sortRenames(renames);
+      // Deleted symbols are left without references, so that they are
+      // named last.
+      dropDeleted(renames, deletions);
+    }
+    {
+      PhaseTimer t("AssignNames", mc.phase(&minic::Timings::names));
+      assignWeightedNames(renames);
+    }
+    PhaseTimer t("ApplyRenames", mc.phase(&minic::Timings::apply));
+    auto &sm = ctx.getSourceManager();
+    StringRef code = sm.getBufferData(sm.getMainFileID());
+    mc.newCode = applyRenames(code, renames, deletions, mc);
+    if (mc.stats)
+      count(ctx, code, renames);
+  }
+  /* Find the renames, on mc.threads threads if there are enough decls.
+   * topLevel is cut into contiguous shards, several per thread so that a
+   * shard of large decls does not hold up the rest, and the shards' ranges
+   * are concatenated in order: the result is the same as one Renamer's.
+   */
+  void rename(ASTContext &ctx, std::vector<Rename> &renames) {
+    const size_t minShard = 64;
+    size_t shards = std::min<size_t>(size_t(mc.threads) * 4,
+                                     topLevel.size() / minShard);
+#ifndef NDEBUG
+    // The visitors print to errs().
+    shards = 1;
+#endif
+    // Reading a lazily loaded AST (from a preamble) deserializes decls. The
+    // closure types of lambdas instantiated from templates were built after
+    // the Collector saw the TU, and still build their lookup tables.
+    if (ctx.getExternalSource() || mc.lambdaInTemplate)
+      shards = 1;
+    std::vector<std::vector<RenameRange>> ranges(std::max<size_t>(shards, 1));
+    if (ranges.size() == 1) {
+      Renamer r(ctx, mc, ranges[0]);
+      for (Decl *d : topLevel)
+        r.TraverseDecl(d);
+    } else {
+      prepareRenamers(topLevel);
+      // Renamers are made here: their constructor asks the SourceManager.
+      std::vector<std::unique_ptr<Renamer>> renamers;
+      for (std::vector<RenameRange> &shard : ranges)
+        renamers.push_back(std::make_unique<Renamer>(ctx, mc, shard));
+      MiniThreadPool pool(hardware_concurrency(mc.threads));
+      size_t per = (topLevel.size() + shards - 1) / shards;
+      for (size_t i = 0; i != shards; i++) {
+        ArrayRef<Decl *> shard = ArrayRef<Decl *>(topLevel)
+                                     .slice(std::min(i * per, topLevel.size()))
+                                     .take_front(per);
+        pool.async([r = renamers[i].get(), shard] {
+          for (Decl *d : shard)
+            r->TraverseDecl(d);
+        });
+      }
+      pool.wait();
+    }
+    for (const std::vector<RenameRange> &shard : ranges)
+      resolveRenames(ctx.getSourceManager(), ctx.getLangOpts(), shard,
+                     renames);
+  }
+  void count(ASTContext &ctx, StringRef code,
+             const std::vector<Rename> &renames) {
+    minic::Stats &st = *mc.stats;
+    DenseSet<const CompoundStmt *> scopes;
+    for (const Symbol &sym : mc.symbols) {
+      switch (sym.kind) {
+      case SymbolKind::Function:
+        st.functions++;
+        break;
+      case SymbolKind::Variable:
+        st.variables++;
+        break;
+      case SymbolKind::Field:
+        st.fields++;
+        break;
+      case SymbolKind::Type:
+        st.types++;
+        break;
+      case SymbolKind::EnumConstant:
+        st.enumConstants++;
+        break;
+      }
+      if (sym.scope)
+        scopes.insert(sym.scope);
+    }
+    st.scopes += scopes.size();
+    st.usedNames += mc.reserved.size();
+    st.renames += renames.size();
+    st.inputBytes += code.size();
+    st.renamedBytes += mc.newCode.size();
+    st.astBytes = std::max<uint64_t>(st.astBytes,
+                                     ctx.getASTAllocatedMemory() +
+                                         ctx.getSideTableAllocatedMemory());
+  }
+  void collect(ASTContext &ctx) {
+    PhaseTimer t("Collect", mc.phase(&minic::Timings::collect));
+    // Every identifier seen so far (header decls, macros, keywords) is taken,
+    // including those only known to a precompiled preamble.
+    for (auto &id : ctx.Idents)
+      mc.reserved.insert(id.getKey());
+    if (IdentifierInfoLookup *ext = ctx.Idents.getExternalIdentifierLookup())
+      if (std::unique_ptr<IdentifierIterator> it{ext->getIdentifiers()})
+        for (StringRef name = it->Next(); !name.empty(); name = it->Next())
+          mc.reserved.insert(name);
+
+    collector->finish();
+    // A counter passes at most one number per symbol plus the reserved ones
+    // on its way, and a prefix has at least 4 letters ("nopq").
+    mc.reserved.build((mc.symbols.size() + mc.reserved.candidates()) / 4 + 1);
+  }
+  // Delete the #include lines nothing depends on (see IncludeGraph).
+  void pruneIncludes(ASTContext &ctx) {
+    PhaseTimer t("PruneIncludes", mc.phase(&minic::Timings::collect));
+    findDeclUses(ctx, *includes);
+    auto &sm = ctx.getSourceManager();
+    StringRef code = sm.getBufferData(sm.getMainFileID());
+    std::vector<FileID> removed;
+    for (FileID f : includes->unused()) {
+      Deletion line;
+      if (!includeLine(sm, code, f, line))
+        continue;
+      deletions.push_back(line);
+      removed.push_back(f);
+      if (mc.prunedIncludes)
+        mc.prunedIncludes->push_back(
+            code.slice(line.begin, line.end).rtrim().str());
+    }
+    if (mc.stats) {
+      mc.stats->includesRemoved += removed.size();
+      mc.stats->includeBytesRemoved += includes->bytesUnder(removed);
+    }
+  }
+  // Delete the decls nothing reaches (see findDeadDecls).
+  void stripDead(ASTContext &ctx) {
+    PhaseTimer t("StripDead", mc.phase(&minic::Timings::collect));
+    size_t first = deletions.size();
+    unsigned decls = findDeadDecls(ctx, topLevel, mc.ignores, deletions);
+    if (mc.stats) {
+      mc.stats->deadDecls += decls;
+      for (size_t i = first; i != deletions.size(); i++)
+        mc.stats->deadBytes += deletions[i].end - deletions[i].begin;
+    }
+  }
+  /* A name costs its length at each of its references, so the shortest names
+   * go to the most referenced decls: names are handed out in order of
+   * decreasing reference count, which getName turns into short names first
+   * within each of its namespaces (functions, globals, fields, ...). Ties
+   * keep the order of the symbols. nameLocals gives the shortest names to
+   * the colours whose locals have the most references.
+   */
+  void assignWeightedNames(ArrayRef<Rename> renames) {
+    std::vector<unsigned> refs(mc.symbols.size()), order(mc.symbols.size());
+    for (const Rename &r : renames)
+      refs[r.nameId]++;
+    std::iota(order.begin(), order.end(), 0);
+    auto cost = [&] {
+      int64_t bytes = 0;
+      for (unsigned i = 0; i != refs.size(); i++)
+        bytes += int64_t(refs[i]) * mc.symbols[i].name.size();
+      return bytes;
+    };
+    int64_t unweighted = 0;
+    if (mc.stats) {
+      assignNames(order, {});
+      unweighted = cost();
+    }
+    llvm::stable_sort(
+        order, [&](unsigned a, unsigned b) { return refs[a] > refs[b]; });
+    assignNames(order, refs);
+    if (mc.stats)
+      mc.stats->weightingSavedBytes += unweighted - cost();
+  }
+  // Name the symbols, visiting them in order; refs (if not empty) weighs the
+  // locals.
+  void assignNames(ArrayRef<unsigned> order, ArrayRef<unsigned> refs) {
+    n_fn = n_var = n_fld = n_type = n_enumconst = 0;
+    for (unsigned i : order) {
+      Symbol &sym = mc.symbols[i];
+      if (sym.scope)
+        continue;
+      StringRef vName = cast<NamedDecl>(sym.decl)->getName();
+#ifndef NDEBUG
+      errs() << "kind: " << int(sym.kind) << ", renaming from " << vName;
+#endif
+      switch (sym.kind) {
+      case SymbolKind::Function:
+        sym.name = getName(vName, "abcdefghijklm", n_fn);
+        break;
+      case SymbolKind::Variable:
+        // global variables, should not share w/ local
+        sym.name = getName(vName, "nopq", n_var);
+        break;
+      case SymbolKind::Field:
+        sym.name = getName(vName, "nopqrstuvwxyz", n_fld);
+        break;
+      case SymbolKind::Type:
+        sym.name = getName(vName, "ABCDEFGHIJKLM", n_type);
+        break;
+      case SymbolKind::EnumConstant:
+        sym.name = getName(vName, "NOPQRSTUVWXYZ", n_enumconst);
+        break;
+      }
+#ifndef NDEBUG
+      errs() << " to " << sym.name << "\n";
+#endif
+    }
+    nameLocals(order, refs);
+  }
+  /* Name the locals (and parameters) as a colouring of their scope ranges. A
+   * local is in scope from its declaration to the end of its block (of its
+   * function, for a parameter); two locals may share a name unless those
+   * ranges overlap, which also keeps an inner local from hiding an outer one
+   * that is used inside it. A sweep over the ranges by position gives each
+   * local the lowest colour free where it starts, which takes as few colours
+   * as there are locals in scope at once at most. The colours are then
+   * ranked by the references to their locals, most first; on a tie, or
+   * without refs, by where their first local is in order. The colour ranked
+   * k is the k-th name from "rstuvwxyz", unless that is not shorter than the
+   * local's own name, which it then keeps (and which cannot clash: every
+   * existing identifier is reserved).
+   */
+  void nameLocals(ArrayRef<unsigned> order, ArrayRef<unsigned> refs) {
+    struct Local {
+      unsigned id, begin, end, colour;
+    };
+    auto &sm = ctx->getSourceManager();
+    auto begin = [&](SourceLocation loc) {
+      return sm.getFileOffset(sm.getExpansionLoc(loc));
+    };
+    auto end = [&](SourceLocation loc) {
+      return sm.getFileOffset(sm.getExpansionRange(loc).getEnd());
+    };
+    std::vector<Local> locals;
+    for (unsigned i : order) {
+      const Symbol &sym = mc.symbols[i];
+      if (!sym.scope)
+        continue;
+      SourceLocation last = sym.scope->getRBracLoc();
+      if (auto *pvd = dyn_cast<ParmVarDecl>(sym.decl))
+        if (auto *fd = dyn_cast<FunctionDecl>(pvd->getDeclContext()))
+          last = fd->getSourceRange().getEnd();
+      locals.push_back({i, begin(sym.decl->getLocation()), end(last), 0});
+    }
+
+    std::vector<unsigned> byPos(locals.size());
+    std::iota(byPos.begin(), byPos.end(), 0);
+    llvm::sort(byPos, [&](unsigned a, unsigned b) {
+      return std::make_tuple(locals[a].begin, -int64_t(locals[a].end), a) <
+             std::make_tuple(locals[b].begin, -int64_t(locals[b].end), b);
+    });
+    // The locals in scope by the end of their range, soonest first, and the
+    // colours they have given back.
+    using Active = std::pair<unsigned, unsigned>;
+    std::priority_queue<Active, std::vector<Active>, std::greater<Active>>
+        active;
+    std::priority_queue<unsigned, std::vector<unsigned>, std::greater<>> freed;
+    unsigned colours = 0;
+    for (unsigned i : byPos) {
+      Local &l = locals[i];
+      for (; !active.empty() && active.top().first < l.begin; active.pop())
+        freed.push(locals[active.top().second].colour);
+      if (freed.empty())
+        l.colour = colours++;
+      else {
+        l.colour = freed.top();
+        freed.pop();
+      }
+      active.push({l.end, i});
+    }
+
+    // locals is in order, so the first local of a colour has the least index.
+    std::vector<uint64_t> weight(colours);
+    std::vector<unsigned> first(colours, ~0u), rank(colours);
+    for (unsigned i = 0; i != locals.size(); i++) {
+      first[locals[i].colour] = std::min(first[locals[i].colour], i);
+      if (!refs.empty())
+        weight[locals[i].colour] += refs[locals[i].id];
+    }
+    std::vector<unsigned> byWeight(colours);
+    std::iota(byWeight.begin(), byWeight.end(), 0);
+    llvm::sort(byWeight, [&](unsigned a, unsigned b) {
+      return std::make_pair(-int64_t(weight[a]), first[a]) <
+             std::make_pair(-int64_t(weight[b]), first[b]);
+    });
+    for (unsigned k = 0; k != colours; k++)
+      rank[byWeight[k]] = k;
+
+    for (const Local &l : locals) {
+      Symbol &sym = mc.symbols[l.id];
+      StringRef origName = cast<NamedDecl>(sym.decl)->getName();
+      StringRef name = localName(rank[l.colour]);
+      sym.name = name.size() < origName.size() ? name : mc.saver.save(origName);
+    }
+  }
+  StringRef localName(unsigned colour) {
+    while (localNames.size() <= colour)
+      localNames.push_back(mc.saver.save(nextName("rstuvwxyz", n_local)));
+    return localNames[colour];
+  }
+};
+
+struct MiniAction : ASTFrontendAction {
+  MiniContext &mc;
+
+  MiniAction(MiniContext &mc) : mc(mc) {}
+  std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &ci,
+                                                 StringRef inFile) override {
+    auto consumer = std::make_unique<MiniASTConsumer>(mc);
+    if (mc.pruneIncludes) {
+      consumer->includes.emplace(ci.getSourceManager());
+      ci.getPreprocessor().addPPCallbacks(
+          makeIncludeCallbacks(*consumer->includes));
+    }
+    return consumer;
+  }
+};
+
+static Error reformat(std::string &code) {
+  auto buf = MemoryBuffer::getMemBuffer(code, "", true);
+  format::FormatStyle style =
+      cantFail(format::getStyle("LLVM", "-", "LLVM", code, nullptr));
+  style.ColumnLimit = 9999;
+  style.IndentWidth = 0;
+  style.ContinuationIndentWidth = 0;
+  style.SpaceBeforeAssignmentOperators = false;
+  style.SpaceBeforeParens = format::FormatStyle::SBPO_Never;
+  style.AlignEscapedNewlines = format::FormatStyle::ENAS_DontAlign;
+  // Only whitespace may change: no reordered using-declarations, no added
+  // namespace comments, and no string literal longer than ColumnLimit split.
+#if LLVM_VERSION_MAJOR >= 17
+  style.SortUsingDeclarations = format::FormatStyle::SUD_Never;
+#else
+  style.SortUsingDeclarations = false;
+#endif
+  style.FixNamespaceComments = false;
+  style.BreakStringLiterals = false;
+
+  format::FormattingAttemptStatus status;
+  std::vector<tooling::Range> ranges{{0, unsigned(code.size())}};
+  tooling::Replacements reps =
+      format::reformat(style, code, ranges, "-", &status);
+  auto res = tooling::applyAllReplacements(code, reps);
+  if (!res)
+    return createStringError(inconvertibleErrorCode(),
+                             "failed to apply replacements: %s",
+                             toString(res.takeError()).c_str());
+  code = *res;
+  return Error::success();
+}
+
+Expected<std::string> minifyInvocation(std::unique_ptr<CompilerInvocation> ci,
+                                       const minic::Options &opts) {
+  IntrusiveRefCntPtr<vfs::FileSystem> fs =
+      opts.fs ? opts.fs : vfs::getRealFileSystem();
+  // A preamble would hide its includes from the callbacks of pruneIncludes.
+  if (opts.preambles && !opts.pruneIncludes) {
+    // Hand the main file to clang as a remapped buffer, so that it is read
+    // once for both the preamble check and the parse.
+    PreprocessorOptions &pp = ci->getPreprocessorOpts();
+    StringRef file = ci->getFrontendOpts().Inputs[0].getFile();
+    const MemoryBuffer *mainFile = nullptr;
+    for (auto &[name, buf] : pp.RemappedFileBuffers)
+      if (name == file)
+        mainFile = buf;
+    if (!mainFile) {
+      SmallString<256> path(file);
+      StringRef cwd = ci->getFileSystemOpts().WorkingDir;
+      if (!cwd.empty())
+        sys::fs::make_absolute(cwd, path);
+      if (auto buf = fs->getBufferForFile(path)) {
+        mainFile = buf->get();
+        pp.addRemappedFile(file, buf->release());
+      }
+    }
+    if (mainFile)
+      opts.preambles->apply(*ci, *mainFile, fs);
+  }
+
+  IgnoringDiagConsumer dc;
+  auto inst = std::make_unique<CompilerInstance>(
+      std::make_shared<PCHContainerOperations>());
+  inst->setInvocation(std::move(ci));
+  inst->createDiagnostics(&dc, false);
+  inst->getDiagnostics().setIgnoreAllWarnings(true);
+  inst->setTarget(TargetInfo::CreateTargetInfo(
+      inst->getDiagnostics(), inst->getInvocation().TargetOpts));
+  if (!inst->hasTarget())
+    return createStringError(inconvertibleErrorCode(),
+                             "hasTarget returns false");
+  inst->createFileManager(fs);
+  inst->setSourceManager(
+      new SourceManager(inst->getDiagnostics(), inst->getFileManager(), true));
+  std::shared_ptr<AllDependencies> collector;
+  if (opts.deps) {
+    collector = std::make_shared<AllDependencies>();
+    inst->addDependencyCollector(collector);
+  }
+
+  MiniContext mc;
+  mc.ignores = opts.ignores;
+  mc.threads = opts.threads;
+  mc.pruneIncludes = opts.pruneIncludes;
+  mc.prunedIncludes = opts.prunedIncludes;
+  mc.stripDead = opts.stripDead;
+  mc.timings = opts.timings;
+  mc.stats = opts.stats;
+  mc.parsing.emplace(nullptr, mc.phase(&minic::Timings::parse));
+  MiniAction action(mc);
+  if (!action.BeginSourceFile(*inst, inst->getFrontendOpts().Inputs[0]))
+    return createStringError(inconvertibleErrorCode(), "failed to parse");
+  if (Error e = action.Execute()) {
+    consumeError(std::move(e));
+    return createStringError(inconvertibleErrorCode(), "failed to execute");
+  }
+  action.EndSourceFile();
+  if (collector) {
+    StringRef mainFile = inst->getFrontendOpts().Inputs[0].getFile();
+    StringRef cwd = inst->getFileSystemOpts().WorkingDir;
+    for (const std::string &dep : collector->getDependencies()) {
+      if (dep == mainFile)
+        continue;
+      SmallString<256> path(dep);
+      if (!cwd.empty())
+        sys::fs::make_absolute(cwd, path);
+      else
+        sys::fs::make_absolute(path);
+      opts.deps->emplace_back(path);
+    }
+  }
+  // postProcess alone already emits each token with just the whitespace it
+  // needs, and clang-format in front of it only moves whitespace around.
+  if (opts.reformat) {
+    PhaseTimer t("Reformat", mc.phase(&minic::Timings::reformat));
+    if (Error e = reformat(mc.newCode))
+      return std::move(e);
+    if (mc.stats)
+      mc.stats->reformattedBytes += mc.newCode.size();
+  }
+  {
+    PhaseTimer t("PostProcess", mc.phase(&minic::Timings::postProcess));
+    postProcess(mc.newCode);
+  }
+  if (mc.stats) {
+    mc.stats->outputBytes += mc.newCode.size();
+    mc.stats->arenaBytes =
+        std::max<uint64_t>(mc.stats->arenaBytes, mc.alloc.getTotalMemory());
+  }
+  return std::move(mc.newCode);
+}
+} // namespace clang
+
+static Expected<std::string> minifyCode(StringRef code, bool copy,
+                                        ArrayRef<const char *> args,
+                                        const minic::Options &opts) {
+  if (opts.lexicalOnly) {
+    std::string out(code);
+    {
+      PhaseTimer t("PostProcess",
+                   opts.timings ? &opts.timings->postProcess : nullptr);
+      postProcess(out);
+    }
+    if (opts.stats) {
+      opts.stats->inputBytes += code.size();
+      opts.stats->renamedBytes += code.size();
+      opts.stats->outputBytes += out.size();
+    }
+    return std::move(out);
+  }
+  IntrusiveRefCntPtr<vfs::FileSystem> fs =
+      opts.fs ? opts.fs : vfs::getRealFileSystem();
+  std::unique_ptr<CompilerInvocation> ci;
+  {
+    PhaseTimer t("BuildCompilerInvocation",
+                 opts.timings ? &opts.timings->driver : nullptr);
+    ci = buildCompilerInvocation(args, fs);
+  }
+  if (!ci)
+    return createStringError(inconvertibleErrorCode(),
+                             "failed to build CompilerInvocation");
+  StringRef file = ci->getFrontendOpts().Inputs[0].getFile();
+  // The SourceManager takes ownership of the remapped buffer (but not of the
+  // memory of a non-copying one).
+  ci->getPreprocessorOpts().addRemappedFile(
+      file, (copy ? MemoryBuffer::getMemBufferCopy(code, file)
+                  : MemoryBuffer::getMemBuffer(code, file))
+                .release());
+  return minifyInvocation(std::move(ci), opts);
+}
+
+Expected<std::string> minic::minify(StringRef code,
+                                    ArrayRef<const char *> args,
+                                    const Options &opts) {
+  return minifyCode(code, true, args, opts);
+}
+
+Expected<std::string> minic::minify(const MemoryBuffer &buf,
+                                    ArrayRef<const char *> args,
+                                    const Options &opts) {
+  return minifyCode(buf.getBuffer(), false, args, opts);
+}
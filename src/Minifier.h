@@ -0,0 +1,25 @@
+#pragma once
+
+#include "common.h"
+#include "minic.h"
+
+namespace clang {
+// DependencyCollector skips system headers by default; we want all of them.
+struct AllDependencies : DependencyCollector {
+  bool needSystemDependencies() override { return true; }
+};
+
+// Run the driver on a minic command line and return the cc1 invocation.
+std::unique_ptr<CompilerInvocation>
+buildCompilerInvocation(ArrayRef<const char *> args,
+                        IntrusiveRefCntPtr<vfs::FileSystem> fs);
+
+/*
+ * Run the whole pipeline (parse, collect, rename, postProcess) on one TU.
+ * Safe to call from several threads: each call has its own FileManager, on
+ * top of opts.fs. With opts.preambles, the leading #include block is loaded
+ * from (or added to) that PCH cache instead of being parsed.
+ */
+Expected<std::string> minifyInvocation(std::unique_ptr<CompilerInvocation> ci,
+                                       const minic::Options &opts);
+} // namespace clang
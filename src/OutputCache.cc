@@ -0,0 +1,168 @@
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+#include "OutputCache.h"
+
+static void hashField(BLAKE3 &hasher, StringRef s) {
+  hasher.update(s);
+  hasher.update(StringRef("\0", 1));
+}
+
+// Write data to a temporary file next to path and rename it into place, so
+// that concurrent readers see either nothing or the whole file.
+static bool writeAtomic(StringRef path, StringRef data) {
+  SmallString<256> tmp;
+  int fd;
+  if (sys::fs::createUniqueFile(path + ".%%%%%%", fd, tmp))
+    return false;
+  raw_fd_ostream os(fd, true);
+  os << data;
+  os.close();
+  if (os.has_error() || sys::fs::rename(tmp, path)) {
+    os.clear_error();
+    sys::fs::remove(tmp);
+    return false;
+  }
+  return true;
+}
+
+static bool reflink(StringRef from, StringRef to) {
+#ifdef FICLONE
+  int in, out;
+  if (sys::fs::openFileForRead(from, in))
+    return false;
+  if (sys::fs::openFileForWrite(to, out, sys::fs::CD_CreateNew)) {
+    ::close(in);
+    return false;
+  }
+  bool ok = ::ioctl(out, FICLONE, in) == 0;
+  ::close(in);
+  ::close(out);
+  if (!ok)
+    sys::fs::remove(to);
+  return ok;
+#else
+  return false;
+#endif
+}
+
+std::string OutputCache::key(StringRef code, ArrayRef<std::string> args,
+                             const minic::Options &opts) {
+  BLAKE3 hasher;
+  hashField(hasher, MINIC_VERSION);
+  hashField(hasher, getClangFullVersion());
+  hashField(hasher, std::to_string(args.size()));
+  for (const std::string &arg : args)
+    hashField(hasher, arg);
+  hashField(hasher, std::to_string(opts.ignores.size()));
+  for (StringRef name : opts.ignores)
+    hashField(hasher, name);
+  hashField(hasher, opts.reformat ? "reformat" : "");
+  hashField(hasher, opts.lexicalOnly ? "lexical-only" : "");
+  hashField(hasher, opts.pruneIncludes ? "prune-includes" : "");
+  hashField(hasher, opts.stripDead ? "strip-dead" : "");
+  hasher.update(code);
+  return toHex(hasher.final(), true);
+}
+
+std::string OutputCache::hashFile(vfs::FileSystem &fs, StringRef path) {
+  {
+    std::lock_guard<std::mutex> lock(mu);
+    if (auto it = fileHashes.find(path); it != fileHashes.end())
+      return it->second;
+  }
+  auto buf = fs.getBufferForFile(path);
+  if (!buf)
+    return {};
+  BLAKE3 hasher;
+  hasher.update((*buf)->getBuffer());
+  std::string hash = toHex(hasher.final(), true);
+  std::lock_guard<std::mutex> lock(mu);
+  return fileHashes.try_emplace(path, std::move(hash)).first->second;
+}
+
+std::string OutputCache::outputPath(StringRef key, StringRef manifest) {
+  BLAKE3 hasher;
+  hashField(hasher, key);
+  hasher.update(manifest);
+  SmallString<256> path(dir);
+  sys::path::append(path, toHex(hasher.final(), true) + ".out");
+  return std::string(path);
+}
+
+// Each line of the .deps manifest is "<content hash> <path>".
+std::string OutputCache::lookup(StringRef key, vfs::FileSystem &fs) {
+  SmallString<256> depsPath(dir);
+  sys::path::append(depsPath, key + ".deps");
+  if (auto manifest = MemoryBuffer::getFile(depsPath)) {
+    SmallVector<StringRef, 0> lines;
+    (*manifest)->getBuffer().split(lines, '\n', -1, false);
+    bool fresh = llvm::all_of(lines, [&](StringRef line) {
+      auto [hash, path] = line.split(' ');
+      return hashFile(fs, path) == hash;
+    });
+    if (fresh) {
+      std::string out = outputPath(key, (*manifest)->getBuffer());
+      if (sys::fs::exists(out)) {
+        hits++;
+        return out;
+      }
+    }
+  }
+  misses++;
+  return {};
+}
+
+void OutputCache::store(StringRef key, ArrayRef<std::string> deps,
+                        StringRef code, vfs::FileSystem &fs) {
+  std::string manifest;
+  for (const std::string &dep : deps) {
+    std::string hash = hashFile(fs, dep);
+    if (hash.empty())
+      return;
+    manifest += hash + ' ' + dep + '\n';
+  }
+  // The manifest goes last so that it never names a missing output.
+  SmallString<256> depsPath(dir);
+  sys::path::append(depsPath, key + ".deps");
+  if (writeAtomic(outputPath(key, manifest), code))
+    writeAtomic(depsPath, manifest);
+}
+
+bool copyCached(StringRef from, StringRef output, bool link) {
+  if (output == "-") {
+    auto buf = MemoryBuffer::getFile(from);
+    if (!buf)
+      return false;
+    outs() << (*buf)->getBuffer();
+    outs().flush();
+    return !outs().has_error();
+  }
+  sys::fs::file_status st;
+  bool exists = !sys::fs::status(output, st);
+  // Devices such as /dev/null cannot be replaced by a rename.
+  if (exists && st.type() != sys::fs::file_type::regular_file)
+    return !sys::fs::copy_file(from, output);
+
+  // Replace the file a symlink points to, not the symlink.
+  SmallString<256> target(output), tmp;
+  if (exists)
+    sys::fs::real_path(output, target);
+  sys::fs::createUniquePath(target + ".%%%%%%", tmp, false);
+  bool linked = false, ok = reflink(from, tmp);
+  if (!ok && link)
+    ok = linked = !sys::fs::create_hard_link(from, tmp);
+  if (!ok)
+    ok = !sys::fs::copy_file(from, tmp);
+  // A file edited in place (-i) keeps its mode.
+  if (ok && !linked && exists)
+    sys::fs::setPermissions(tmp, st.permissions());
+  if (!ok || sys::fs::rename(tmp, target)) {
+    sys::fs::remove(tmp);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+
+#include "common.h"
+#include "minic.h"
+
+/*
+ * On-disk cache of minified outputs, so that unchanged files skip the
+ * frontend altogether. An entry is found in two steps, like ccache's direct
+ * mode: the key (a hash of the input bytes, the command line, the output
+ * options and the minic and clang versions) names a <key>.deps manifest
+ * listing every header the input read along with a hash of its contents, and
+ * the stored output is <hash of key and manifest>.out. A hit therefore only
+ * reads and hashes files; no CompilerInstance is created.
+ */
+class OutputCache {
+  std::string dir;
+  // Content hash per header path. Files are assumed not to change during one
+  // run, as with FileCache.
+  std::mutex mu;
+  StringMap<std::string> fileHashes;
+  std::atomic<unsigned> hits{0}, misses{0};
+
+  std::string hashFile(vfs::FileSystem &fs, StringRef path);
+  std::string outputPath(StringRef key, StringRef manifest);
+
+public:
+  OutputCache(StringRef dir) : dir(dir) {}
+
+  static std::string key(StringRef code, ArrayRef<std::string> args,
+                         const minic::Options &opts);
+
+  // The stored output for key, or an empty string if there is none or one of
+  // the headers it was made from has changed.
+  std::string lookup(StringRef key, vfs::FileSystem &fs);
+  void store(StringRef key, ArrayRef<std::string> deps, StringRef code,
+             vfs::FileSystem &fs);
+
+  unsigned getHits() const { return hits; }
+  unsigned getMisses() const { return misses; }
+};
+
+/*
+ * Replace output ("-" for stdout) with a copy of the cached file at from: a
+ * reflink where the file system supports it, else (with link) a hard link,
+ * else a plain copy.
+ * Hard links share the inode with the cache, so only pass link for outputs
+ * nobody edits in place.
+ */
+bool copyCached(StringRef from, StringRef output, bool link);
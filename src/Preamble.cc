@@ -0,0 +1,123 @@
+#include "Minifier.h"
+#include "Preamble.h"
+
+static std::string hashKey(const CompilerInvocation &ci, StringRef preamble) {
+  BLAKE3 hasher;
+  hasher.update(getClangFullVersion());
+  for (const std::string &arg : ci.getCC1CommandLine()) {
+    hasher.update(arg);
+    hasher.update(StringRef("\0", 1));
+  }
+  hasher.update(preamble);
+  return toHex(hasher.final(), true);
+}
+
+static std::string depsPath(StringRef pch) { return (pch + ".deps").str(); }
+
+// Each line of the .deps file is "<size> <mtime> <path>".
+bool PreambleCache::isValid(StringRef pch, vfs::FileSystem &fs) {
+  auto deps = MemoryBuffer::getFile(depsPath(pch));
+  if (!deps || !sys::fs::exists(pch))
+    return false;
+  SmallVector<StringRef, 0> lines;
+  (*deps)->getBuffer().split(lines, '\n', -1, false);
+  for (StringRef line : lines) {
+    auto [size, rest] = line.split(' ');
+    auto [mtime, path] = rest.split(' ');
+    auto st = fs.status(path);
+    if (!st || std::to_string(st->getSize()) != size ||
+        std::to_string(
+            st->getLastModificationTime().time_since_epoch().count()) != mtime)
+      return false;
+  }
+  return true;
+}
+
+bool PreambleCache::build(const CompilerInvocation &ci,
+                          const MemoryBuffer &mainFile,
+                          const PreambleBounds &bounds, StringRef pch,
+                          IntrusiveRefCntPtr<vfs::FileSystem> fs) {
+  auto pchCI = std::make_shared<CompilerInvocation>(ci);
+  FrontendOptions &fe = pchCI->getFrontendOpts();
+  fe.ProgramAction = frontend::GeneratePCH;
+  fe.OutputFile = pch.str();
+  StringRef mainPath = fe.Inputs[0].getFile();
+  PreprocessorOptions &pp = pchCI->getPreprocessorOpts();
+  pp.PrecompiledPreambleBytes = {0, false};
+  // Record the conditional stack so the PCH can serve as a preamble.
+  pp.GeneratePreamble = true;
+  // The copied buffer pointers are owned by ci; parse only the preamble.
+  pp.clearRemappedFiles();
+  pp.addRemappedFile(mainPath, MemoryBuffer::getMemBufferCopy(
+                                   mainFile.getBuffer().take_front(bounds.Size),
+                                   mainPath)
+                                   .release());
+
+  IgnoringDiagConsumer dc;
+  CompilerInstance inst(std::make_shared<PCHContainerOperations>());
+  inst.setInvocation(std::move(pchCI));
+  inst.createDiagnostics(&dc, false);
+  inst.createFileManager(fs);
+  auto deps = std::make_shared<AllDependencies>();
+  inst.addDependencyCollector(deps);
+  GeneratePCHAction action;
+  // A preamble with errors (say, a missing header) is not worth caching.
+  if (!inst.ExecuteAction(action) || inst.getDiagnostics().hasErrorOccurred())
+    return false;
+
+  std::string manifest;
+  for (const std::string &dep : deps->getDependencies()) {
+    if (dep == mainPath)
+      continue;
+    auto st = fs->status(dep);
+    if (!st)
+      return false;
+    manifest += std::to_string(st->getSize()) + ' ' +
+                std::to_string(
+                    st->getLastModificationTime().time_since_epoch().count()) +
+                ' ' + dep + '\n';
+  }
+  // Written last and renamed into place: a .deps file means a complete PCH.
+  SmallString<256> tmp;
+  int fd;
+  if (sys::fs::createUniqueFile(depsPath(pch) + ".%%%%%%", fd, tmp))
+    return false;
+  {
+    raw_fd_ostream os(fd, true);
+    os << manifest;
+  }
+  return !sys::fs::rename(tmp, depsPath(pch));
+}
+
+bool PreambleCache::apply(CompilerInvocation &ci, const MemoryBuffer &mainFile,
+                          IntrusiveRefCntPtr<vfs::FileSystem> fs) {
+#if LLVM_VERSION_MAJOR >= 17
+  const LangOptions &langOpts = ci.getLangOpts();
+#else
+  const LangOptions &langOpts = *ci.getLangOpts();
+#endif
+  PreambleBounds bounds =
+      ComputePreambleBounds(langOpts, mainFile.getMemBufferRef(), 0);
+  if (!bounds.Size)
+    return false;
+
+  SmallString<256> pch(dir);
+  sys::path::append(pch, hashKey(ci, mainFile.getBuffer().take_front(
+                                         bounds.Size)) +
+                             ".pch");
+  if (!isValid(pch, *fs) && !build(ci, mainFile, bounds, pch, fs))
+    return false;
+
+  // The same setup PrecompiledPreamble::AddImplicitPreamble does.
+  PreprocessorOptions &pp = ci.getPreprocessorOpts();
+  pp.PrecompiledPreambleBytes = {bounds.Size, bounds.PreambleEndsAtStartOfLine};
+  pp.DisablePCHOrModuleValidation = DisableValidationForModuleKind::PCH;
+  // Predefines are part of the PCH already.
+  pp.UsePredefines = false;
+  pp.ImplicitPCHInclude = std::string(pch);
+  return true;
+}
+
+std::shared_ptr<PreambleCache> minic::makePreambleCache(StringRef dir) {
+  return std::make_shared<PreambleCache>(dir);
+}
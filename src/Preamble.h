@@ -0,0 +1,30 @@
+#pragma once
+
+#include "common.h"
+
+/*
+ * On-disk cache of precompiled preambles, i.e. the leading block of
+ * #include/#define lines of a main file. Entries are addressed by a hash of
+ * the preamble text, the cc1 command line and the clang version, and each
+ * entry records the headers it was built from so that an edited header
+ * invalidates it.
+ */
+class PreambleCache {
+  std::string dir;
+
+  bool isValid(StringRef pch, vfs::FileSystem &fs);
+  bool build(const CompilerInvocation &ci, const MemoryBuffer &mainFile,
+             const PreambleBounds &bounds, StringRef pch,
+             IntrusiveRefCntPtr<vfs::FileSystem> fs);
+
+public:
+  PreambleCache(StringRef dir) : dir(dir) {}
+
+  /*
+   * Make ci load a PCH for the preamble of mainFile instead of parsing it,
+   * building and storing the PCH first if needed. Returns false and leaves
+   * ci untouched when there is no usable preamble.
+   */
+  bool apply(CompilerInvocation &ci, const MemoryBuffer &mainFile,
+             IntrusiveRefCntPtr<vfs::FileSystem> fs);
+};
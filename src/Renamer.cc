@@ -1,11 +1,175 @@
 #include "Renamer.h"
 
+Renamer::Renamer(ASTContext &ctx, const MiniContext &mc,
+                 std::vector<RenameRange> &ranges)
+    : ranges(ranges), ctx{ctx}, mc{mc} {
+  const SourceManager &sm = ctx.getSourceManager();
+  FileID main = sm.getMainFileID();
+  mainBegin = sm.getLocForStartOfFile(main).getRawEncoding();
+  mainEnd = sm.getLocForEndOfFile(main).getRawEncoding();
+}
+
+void Renamer::replace(CharSourceRange csr, unsigned nameId) {
+  if ((patterns || instantiations) &&
+      !recorded
+           .insert({csr.getBegin().getRawEncoding(),
+                    csr.getEnd().getRawEncoding(), nameId})
+           .second)
+    return;
+  ranges.push_back({csr, nameId});
+}
+
+static bool isImplicitInstantiation(const Decl *d) {
+  if (auto *fd = dyn_cast<FunctionDecl>(d))
+    return fd->getTemplateSpecializationKind() == TSK_ImplicitInstantiation;
+  if (auto *rd = dyn_cast<CXXRecordDecl>(d))
+    return rd->getTemplateSpecializationKind() == TSK_ImplicitInstantiation;
+  if (auto *vd = dyn_cast<VarDecl>(d))
+    return vd->getTemplateSpecializationKind() == TSK_ImplicitInstantiation;
+  return false;
+}
+
+bool Renamer::TraverseDecl(Decl *d) {
+  if (!d)
+    return true;
+  bool inst = isImplicitInstantiation(d), pattern = !inst && d->isTemplated();
+  patterns += pattern;
+  instantiations += inst;
+  bool ok = RecursiveASTVisitor::TraverseDecl(d);
+  patterns -= pattern;
+  instantiations -= inst;
+  return ok;
+}
+
+static Renamer::StmtKey stmtKey(const Stmt *s) {
+  return {s->getBeginLoc().getRawEncoding(), s->getEndLoc().getRawEncoding(),
+          s->getStmtClass()};
+}
+
+// False skips s and its children.
+bool Renamer::dataTraverseStmtPre(Stmt *s) {
+  if (!isTemplateStmt(s))
+    return true;
+  if (instantiations && plainStmts.contains(stmtKey(s)))
+    return false;
+  outerDependent.push_back(dependent);
+  dependent = isa<CXXDependentScopeMemberExpr, DependentScopeDeclRefExpr,
+                  UnresolvedLookupExpr, UnresolvedMemberExpr>(s);
+  if (auto *e = dyn_cast<Expr>(s))
+    dependent |= e->isTypeDependent();
+  return true;
+}
+
+// Called once the children of s are traversed, unless Pre skipped it.
+bool Renamer::dataTraverseStmtPost(Stmt *s) {
+  if (!isTemplateStmt(s))
+    return true;
+  if (!instantiations && !dependent)
+    plainStmts.insert(stmtKey(s));
+  dependent |= outerDependent.back();
+  outerDependent.pop_back();
+  return true;
+}
+
+// Template parameters themselves are substituted by types that VisitTypeLoc
+// never renames; types named through them may resolve to ones it does.
+bool Renamer::TraverseTypeLoc(TypeLoc tl) {
+  if (!tl.isNull() && tl.getType()->isDependentType() &&
+      (tl.getAs<DependentNameTypeLoc>() ||
+       tl.getAs<DependentTemplateSpecializationTypeLoc>() ||
+       tl.getAs<TemplateSpecializationTypeLoc>()))
+    dependent = true;
+  return RecursiveASTVisitor::TraverseTypeLoc(tl);
+}
+
+/*
+ * Compute each rename as tooling::Replacement would from the spelling
+ * locations. Ranges not spelled in the main file are dropped: their offsets
+ * would point into some other buffer.
+ */
+void resolveRenames(const SourceManager &sm, const LangOptions &lo,
+                    ArrayRef<RenameRange> ranges,
+                    std::vector<Rename> &renames) {
+  renames.reserve(renames.size() + ranges.size());
+  for (const RenameRange &r : ranges) {
+    SourceLocation b = sm.getSpellingLoc(r.range.getBegin()),
+                   e = sm.getSpellingLoc(r.range.getEnd());
+    auto [fid, begin] = sm.getDecomposedLoc(b);
+    auto [efid, end] = sm.getDecomposedLoc(e);
+    if (fid != sm.getMainFileID() || efid != fid)
+      continue;
+    if (r.range.isTokenRange())
+      end += Lexer::MeasureTokenLength(e, sm, lo);
+    if (end >= begin)
+      renames.push_back({begin, end - begin, r.nameId});
+  }
+}
+
+void sortRenames(std::vector<Rename> &renames) {
+  // Template instantiations revisit the same tokens; after sorting the
+  // repeats are adjacent.
+  llvm::stable_sort(renames, [](const Rename &a, const Rename &b) {
+    return a.offset < b.offset;
+  });
+  auto out = renames.begin();
+  size_t pos = 0;
+  for (const Rename &r : renames) {
+    if (r.offset < pos)
+      continue;
+    *out++ = r;
+    pos = r.offset + r.length;
+  }
+  renames.erase(out, renames.end());
+}
+
+void dropDeleted(std::vector<Rename> &renames, ArrayRef<Deletion> deletions) {
+  auto out = renames.begin();
+  auto del = deletions.begin();
+  for (const Rename &r : renames) {
+    while (del != deletions.end() && del->end <= r.offset)
+      ++del;
+    if (del == deletions.end() || r.offset < del->begin)
+      *out++ = r;
+  }
+  renames.erase(out, renames.end());
+}
+
+std::string applyRenames(StringRef code, ArrayRef<Rename> renames,
+                         ArrayRef<Deletion> deletions, const MiniContext &mc) {
+  std::string out;
+  out.reserve(code.size());
+  size_t pos = 0;
+  auto del = deletions.begin();
+  // Copy code up to end, skipping the deletions that start by then.
+  auto copyTo = [&](size_t end) {
+    for (; del != deletions.end() && del->begin <= end; ++del) {
+      if (del->begin > pos)
+        out.append(code.data() + pos, del->begin - pos);
+      pos = std::max<size_t>(pos, del->end);
+    }
+    if (end > pos)
+      out.append(code.data() + pos, end - pos);
+    pos = std::max(pos, end);
+  };
+  for (const Rename &r : renames) {
+    if (r.offset < pos)
+      continue;
+    copyTo(r.offset);
+    if (r.offset < pos)
+      continue;
+    out += mc.symbols[r.nameId].name;
+    pos = r.offset + r.length;
+  }
+  copyTo(code.size());
+  return out;
+}
+
 bool Renamer::VisitFunctionDecl(FunctionDecl *fd) {
-  if (!sm.isWrittenInMainFile(fd->getLocation()))
+  if (!isWrittenInMainFile(fd->getLocation()))
     return true;
   auto *canon = fd->getCanonicalDecl();
-  lookup(canon, [&](DeclMapData &dmd) {
-    replace(CharSourceRange::getTokenRange(fd->getLocation()), dmd.name);
+  lookup(canon, [&](unsigned id) {
+    replace(CharSourceRange::getTokenRange(fd->getLocation()), id);
   });
   return true;
 }
@@ -13,13 +177,13 @@ bool Renamer::VisitFunctionDecl(FunctionDecl *fd) {
 // CXXConstructorDecl is a special kind of FunctionDecl/CXXMethodDecl that
 // needs to be renamed to its parent class
 bool Renamer::VisitCXXConstructorDecl(CXXConstructorDecl *ccd) {
-  if (!sm.isWrittenInMainFile(ccd->getLocation()))
+  if (!isWrittenInMainFile(ccd->getLocation()))
     return true;
   // the canon decl should be the same as its class's (in other words,
   // its parent's)
   auto *canon = ccd->getParent()->getCanonicalDecl();
-  lookup(canon, [&](DeclMapData &dmd) {
-    replace(CharSourceRange::getTokenRange(ccd->getLocation()), dmd.name);
+  lookup(canon, [&](unsigned id) {
+    replace(CharSourceRange::getTokenRange(ccd->getLocation()), id);
     for (CXXCtorInitializer *cci : ccd->inits())
       VisitCXXCtorInitializer(cci);
     for (ParmVarDecl *param : ccd->parameters())
@@ -31,17 +195,27 @@ bool Renamer::VisitCXXConstructorDecl(CXXConstructorDecl *ccd) {
 
 // And constructor leads to another oddity: C++ base/member initializer
 bool Renamer::VisitCXXCtorInitializer(CXXCtorInitializer *cci) {
-  if (!sm.isWrittenInMainFile(cci->getSourceLocation()))
+  if (!isWrittenInMainFile(cci->getSourceLocation()))
     return true;
   auto *canon = cci->getMember()->getCanonicalDecl();
-  lookup(canon, [&](DeclMapData &dmd) {
-    replace(CharSourceRange::getTokenRange(cci->getSourceLocation()), dmd.name);
+  lookup(canon, [&](unsigned id) {
+    replace(CharSourceRange::getTokenRange(cci->getSourceLocation()), id);
   });
   return true;
 }
 
+ValueDecl *Renamer::findTemplateMember(const ClassTemplateDecl *td,
+                                       const IdentifierInfo *id) {
+  if (indexedTemplates.insert(td).second)
+    for (auto *d : td->getTemplatedDecl()->decls())
+      if (auto *vd = dyn_cast<ValueDecl>(d))
+        // The first declaration of a name wins, as in a linear search.
+        templateMembers.try_emplace({td, vd->getIdentifier()}, vd);
+  return templateMembers.lookup({td, id});
+}
+
 bool Renamer::VisitMemberExpr(MemberExpr *me) {
-  if (!sm.isWrittenInMainFile(me->getExprLoc()))
+  if (!isWrittenInMainFile(me->getExprLoc()))
     return true;
 
   auto *md = me->getMemberDecl();
@@ -52,55 +226,47 @@ bool Renamer::VisitMemberExpr(MemberExpr *me) {
    * but we can barely learn anything from an unresolved template AST.
    */
   if (auto *ctsd =
-          getParent<ClassTemplateSpecializationDecl, decltype(*md)>(*md))
+          dyn_cast<ClassTemplateSpecializationDecl>(md->getDeclContext()))
     if (auto *td =
             ctsd->getInstantiatedFrom().dyn_cast<ClassTemplateDecl *>()) {
 #ifndef NDEBUG
       errs() << "\nFound parent is specialization.\n";
 #endif
-      auto *act_cd = td->getTemplatedDecl();
-      for (auto *d : act_cd->decls()) {
-        ValueDecl *act_md = dynamic_cast<ValueDecl *>(d);
-        if (!act_md)
-          continue;
-        if (IdentifierInfo *act_id = act_md->getIdentifier();
-            act_id == md->getIdentifier()) {
+      if (ValueDecl *act_md = findTemplateMember(td, md->getIdentifier())) {
 #ifndef NDEBUG
-          errs() << "Found corresponding member:\n", act_md->dumpColor();
+        errs() << "Found corresponding member:\n", act_md->dumpColor();
 #endif
-          md = act_md;
-          break;
-        }
+        md = act_md;
       }
     }
 
   auto *canon = md->getCanonicalDecl();
-  lookup(canon, [&](DeclMapData &dmd) {
-    replace(CharSourceRange::getTokenRange(me->getExprLoc()), dmd.name);
+  lookup(canon, [&](unsigned id) {
+    replace(CharSourceRange::getTokenRange(me->getExprLoc()), id);
   });
   return true;
 }
 
 bool Renamer::VisitVarDecl(VarDecl *vd) {
-  if (!sm.isWrittenInMainFile(vd->getLocation()))
+  if (!isWrittenInMainFile(vd->getLocation()))
     return true;
   auto *canon = vd->getCanonicalDecl();
-  lookup(canon, [&](DeclMapData &dmd) {
-    replace(CharSourceRange::getTokenRange(vd->getLocation()), dmd.name);
+  lookup(canon, [&](unsigned id) {
+    replace(CharSourceRange::getTokenRange(vd->getLocation()), id);
   });
   return true;
 }
 
 bool Renamer::VisitDeclRefExpr(DeclRefExpr *dre) {
   Decl *d = dre->getDecl();
-  if (!sm.isWrittenInMainFile(d->getLocation()))
+  if (!isWrittenInMainFile(d->getLocation()))
     return true;
   if (!(isa<FunctionDecl>(d) || isa<VarDecl>(d) || isa<FieldDecl>(d) ||
         isa<TypeDecl>(d) || isa<EnumConstantDecl>(d)))
     return true;
   auto *canon = d->getCanonicalDecl();
-  lookup(canon, [&](DeclMapData &dmd) {
-    replace(CharSourceRange::getTokenRange(dre->getSourceRange()), dmd.name);
+  lookup(canon, [&](unsigned id) {
+    replace(CharSourceRange::getTokenRange(dre->getSourceRange()), id);
   });
 
   if (FunctionDecl *fd = d->getAsFunction()) {
@@ -110,14 +276,14 @@ bool Renamer::VisitDeclRefExpr(DeclRefExpr *dre) {
           tipfd->dumpColor();
 #endif
       canon = tipfd->getCanonicalDecl();
-      lookup(canon, [&](DeclMapData &dmd) {
+      lookup(canon, [&](unsigned id) {
         // only replace the function template name
         replace(CharSourceRange::getTokenRange(
                     SourceRange(dre->getBeginLoc(),
                                 dre->getLAngleLoc().isValid()
                                     ? dre->getLAngleLoc().getLocWithOffset(-1)
                                     : dre->getEndLoc())),
-                dmd.name);
+                id);
       });
     }
   }
@@ -125,27 +291,27 @@ bool Renamer::VisitDeclRefExpr(DeclRefExpr *dre) {
 }
 
 bool Renamer::VisitFieldDecl(FieldDecl *fd) {
-  if (!sm.isWrittenInMainFile(fd->getLocation()))
+  if (!isWrittenInMainFile(fd->getLocation()))
     return true;
   auto *canon = fd->getCanonicalDecl();
-  lookup(canon, [&](DeclMapData &dmd) {
-    replace(CharSourceRange::getTokenRange(fd->getLocation()), dmd.name);
+  lookup(canon, [&](unsigned id) {
+    replace(CharSourceRange::getTokenRange(fd->getLocation()), id);
   });
   return true;
 }
 
 bool Renamer::VisitTypeDecl(TypeDecl *td) {
-  if (!sm.isWrittenInMainFile(td->getLocation()))
+  if (!isWrittenInMainFile(td->getLocation()))
     return true;
   auto *canon = td->getCanonicalDecl();
-  lookup(canon, [&](DeclMapData &dmd) {
-    replace(CharSourceRange::getTokenRange(td->getLocation()), dmd.name);
+  lookup(canon, [&](unsigned id) {
+    replace(CharSourceRange::getTokenRange(td->getLocation()), id);
   });
   return true;
 }
 
 bool Renamer::VisitTypeLoc(TypeLoc tl) {
-  if (!sm.isWrittenInMainFile(tl.getBeginLoc()))
+  if (!isWrittenInMainFile(tl.getBeginLoc()))
     return true;
 
   TypeDecl *td = nullptr;
@@ -165,7 +331,7 @@ bool Renamer::VisitTypeLoc(TypeLoc tl) {
     errs() << "\n", tst->dump(errs(), ctx);
 #endif
     if (const RecordType *rt = tst->getAs<RecordType>()) {
-      if (!sm.isWrittenInMainFile(rt->getDecl()->getLocation()))
+      if (!isWrittenInMainFile(rt->getDecl()->getLocation()))
         return true;
 
       auto *ctsd =
@@ -176,30 +342,57 @@ bool Renamer::VisitTypeLoc(TypeLoc tl) {
       auto *ctd = ctsd->getInstantiatedFrom().dyn_cast<ClassTemplateDecl *>();
       if (!ctd)
         return true;
-      lookup(ctd->getTemplatedDecl(), [&](DeclMapData &dmd) {
+      lookup(ctd->getTemplatedDecl(), [&](unsigned id) {
 #ifndef NDEBUG
-        errs() << "Found underlying name: " << dmd.name << "\n";
+        errs() << "Found underlying decl: "
+               << cast<NamedDecl>(mc.symbols[id].decl)->getName()
+               << "\n";
 #endif
         // We only need to replace its template name here (w/o template args).
         replace(CharSourceRange::getTokenRange(tstl.getTemplateNameLoc()),
-                dmd.name);
+                id);
       });
     }
   }
 
-  lookup(td, [&](DeclMapData &dmd) {
-    replace(CharSourceRange::getTokenRange(tl.getSourceRange()), dmd.name);
+  lookup(td, [&](unsigned id) {
+    replace(CharSourceRange::getTokenRange(tl.getSourceRange()), id);
   });
 
   return true;
 }
 
 bool Renamer::VisitEnumConstantDecl(EnumConstantDecl *ecd) {
-  if (!sm.isWrittenInMainFile(ecd->getLocation()))
+  if (!isWrittenInMainFile(ecd->getLocation()))
     return true;
   auto *canon = ecd->getCanonicalDecl();
-  lookup(canon, [&](DeclMapData &dmd) {
-    replace(CharSourceRange::getTokenRange(ecd->getLocation()), dmd.name);
+  lookup(canon, [&](unsigned id) {
+    replace(CharSourceRange::getTokenRange(ecd->getLocation()), id);
   });
   return true;
 }
+
+// Local classes have no member templates, and generic lambdas are implicit
+// code, which Renamers skip; only decls of namespaces and classes are looked
+// into.
+static void buildTemplateCommons(Decl *d) {
+  if (auto *ctd = dyn_cast<ClassTemplateDecl>(d)) {
+    for (ClassTemplateSpecializationDecl *spec : ctd->specializations())
+      buildTemplateCommons(spec);
+    d = ctd->getTemplatedDecl();
+  } else if (auto *ftd = dyn_cast<FunctionTemplateDecl>(d)) {
+    ftd->specializations();
+    return;
+  } else if (auto *vtd = dyn_cast<VarTemplateDecl>(d)) {
+    vtd->specializations();
+    return;
+  }
+  if (isa<NamespaceDecl, LinkageSpecDecl, ExportDecl, CXXRecordDecl>(d))
+    for (Decl *member : cast<DeclContext>(d)->decls())
+      buildTemplateCommons(member);
+}
+
+void prepareRenamers(ArrayRef<Decl *> topLevel) {
+  for (Decl *d : topLevel)
+    buildTemplateCommons(d);
+}
@@ -1,31 +1,102 @@
 #pragma once
 
-#include "common.h"
-#include <functional>
+#include "Context.h"
 
-extern MapVector<Decl *, DeclMapData> d2name;
+// code[offset, offset + length) of the main file becomes the new name of
+// symbol nameId of MiniContext::symbols.
+struct Rename {
+  unsigned offset, length, nameId;
+};
+
+// code[begin, end) of the main file is left out of the output.
+struct Deletion {
+  unsigned begin, end;
+};
+
+// A Rename before its offsets are known: the token range as found in the AST.
+struct RenameRange {
+  CharSourceRange range;
+  unsigned nameId;
+};
+
+// Turn ranges into Renames, dropping those not spelled in the main file.
+void resolveRenames(const SourceManager &sm, const LangOptions &lo,
+                    ArrayRef<RenameRange> ranges, std::vector<Rename> &renames);
+
+// Sort renames by offset, dropping repeats and overlaps: of overlapping
+// renames the first one recorded wins.
+void sortRenames(std::vector<Rename> &renames);
 
+// Drop the renames inside the sorted deletions.
+void dropDeleted(std::vector<Rename> &renames, ArrayRef<Deletion> deletions);
+
+// Splice sorted renames into code in one pass, leaving out the sorted,
+// disjoint deletions and the renames inside them.
+std::string applyRenames(StringRef code, ArrayRef<Rename> renames,
+                         ArrayRef<Deletion> deletions, const MiniContext &mc);
+
+/*
+ * Finds every reference to a renamed decl. It only reads the AST, the symbols
+ * and the main file's bounds (never the SourceManager, whose lookups update a
+ * cache), so several Renamers may traverse disjoint decls of one TU at once
+ * as long as the AST is not loaded lazily from a precompiled preamble. In
+ * C++, the AST is not all built yet: visiting the instantiations of a
+ * template builds its common data, and a lambda's call operator the lookup
+ * table of its closure type, both on first use and in the ASTContext. See
+ * prepareRenamers and Collector::VisitLambdaExpr.
+ */
 struct Renamer : RecursiveASTVisitor<Renamer> {
-  SourceManager &sm;
-  tooling::Replacements &reps;
+  std::vector<RenameRange> &ranges;
   ASTContext &ctx;
+  const MiniContext &mc;
+  // Raw encodings of the first and last location of the main file.
+  SourceLocation::UIntTy mainBegin, mainEnd;
+  // Members of primary class templates by name, filled in one template at a
+  // time on the first member access through one of its specializations.
+  DenseMap<std::pair<const ClassTemplateDecl *, const IdentifierInfo *>,
+           ValueDecl *>
+      templateMembers;
+  DenseSet<const ClassTemplateDecl *> indexedTemplates;
+
+  /* Instantiations are traversed for the members and types they resolve,
+   * but mostly they repeat their pattern. While in templates, statements of
+   * a pattern that refer to nothing resolved only on instantiation are
+   * remembered by range and class, and the same statements of instantiations
+   * are skipped; ranges already recorded are not recorded again. This is
+   * done in dataTraverseStmtPre/Post, which keep RecursiveASTVisitor's data
+   * recursion: a long chain of operators must not take a stack frame each.
+   */
+  using StmtKey = std::tuple<SourceLocation::UIntTy, SourceLocation::UIntTy,
+                             unsigned>;
+  unsigned patterns = 0, instantiations = 0;
+  // Whether the statement being traversed refers to something dependent,
+  // and the same for each enclosing statement, innermost last.
+  bool dependent = false;
+  std::vector<bool> outerDependent;
+  DenseSet<StmtKey> plainStmts, recorded;
 
-  Renamer(ASTContext &ctx, tooling::Replacements &reps)
-      : sm(ctx.getSourceManager()), reps(reps), ctx{ctx} {}
-  void replace(CharSourceRange csr, StringRef newText) {
-    cantFail(reps.add(tooling::Replacement(sm, csr, newText)));
+  Renamer(ASTContext &ctx, const MiniContext &mc,
+          std::vector<RenameRange> &ranges);
+  // Same as SourceManager::isWrittenInMainFile, without touching its cache.
+  bool isWrittenInMainFile(SourceLocation loc) const {
+    return loc.isFileID() && loc.getRawEncoding() >= mainBegin &&
+           loc.getRawEncoding() <= mainEnd;
   }
-  template <typename T1, typename T2> const T1 *getParent(const T2 &n) {
-    return ::getParent<T1, T2>(ctx, n);
+  // Whether s is a statement of a template or an instantiation to remember.
+  bool isTemplateStmt(Stmt *s) const {
+    return (patterns || instantiations) &&
+           isWrittenInMainFile(s->getBeginLoc());
   }
-  // lookup Decl in the d2name map
-  bool lookup(Decl *d, std::function<void(DeclMapData &)> callback) {
-    bool found = false;
-    if (auto it = d2name.find(d); it != d2name.end())
-      callback(it->second), found = true;
-    return true;
+  void replace(CharSourceRange csr, unsigned nameId);
+  // lookup Decl in the symbol table, passing its number to callback
+  template <typename F> void lookup(Decl *d, F callback) {
+    if (int id = mc.symbols.find(d); id >= 0)
+      callback(unsigned(id));
   }
 
+  ValueDecl *findTemplateMember(const ClassTemplateDecl *td,
+                                const IdentifierInfo *id);
+
   bool VisitFunctionDecl(FunctionDecl *fd);
   // CXXConstructorDecl is a special kind of FunctionDecl/CXXMethodDecl that
   // needs to be renamed to its parent class
@@ -43,7 +114,15 @@ struct Renamer : RecursiveASTVisitor<Renamer> {
    *      https://clang.llvm.org/doxygen/classclang_1_1RecursiveASTVisitor.html#a426895210c9f7c02589702fd412da81b
    */
   bool shouldVisitTemplateInstantiations() const { return true; }
+  bool TraverseDecl(Decl *d);
+  bool dataTraverseStmtPre(Stmt *s);
+  bool dataTraverseStmtPost(Stmt *s);
+  bool TraverseTypeLoc(TypeLoc tl);
   bool VisitTypeDecl(TypeDecl *d);
   bool VisitTypeLoc(TypeLoc tl);
   bool VisitEnumConstantDecl(EnumConstantDecl *ecd);
 };
+
+// Builds the common data of every template in topLevel, members and
+// specializations included, before Renamers traverse it on several threads.
+void prepareRenamers(ArrayRef<Decl *> topLevel);
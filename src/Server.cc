@@ -0,0 +1,140 @@
+#include <stdio.h>
+
+#include "FileCache.h"
+#include "Minifier.h"
+#include "Server.h"
+
+// What a request may hold, so that a malformed header cannot make the server
+// allocate, or wait for, more than a real request would need.
+static const size_t maxArgs = 4096, maxArgLen = 64 << 10,
+                    maxSourceLen = size_t(1) << 30;
+
+enum class Read { Ok, Malformed, End };
+
+// Reads a line without its newline into line, of at most max bytes; the
+// rest of a longer line is skipped.
+static Read readLine(std::string &line, size_t max) {
+  line.clear();
+  for (int c; (c = getchar()) != '\n';) {
+    if (c == EOF)
+      return Read::End;
+    if (line.size() == max) {
+      while ((c = getchar()) != '\n' && c != EOF)
+        ;
+      return Read::Malformed;
+    }
+    line += char(c);
+  }
+  return Read::Ok;
+}
+
+// On Malformed and on End but at a clean end of the input, err says why.
+static Read readRequest(std::vector<std::string> &args, std::string &source,
+                        std::string &err) {
+  std::string header;
+  err.clear();
+  if (Read r = readLine(header, 64); r != Read::Ok) {
+    if (r == Read::Malformed || !header.empty())
+      err = "malformed request header";
+    return r;
+  }
+  size_t nargs, len;
+  auto [first, second] = StringRef(header).split(' ');
+  if (first.getAsInteger(10, nargs) || second.getAsInteger(10, len)) {
+    err = "malformed request header: " + header;
+    return Read::Malformed;
+  }
+  if (nargs > maxArgs || len > maxSourceLen) {
+    err = ("request too large: " + Twine(nargs) + " arguments, " + Twine(len) +
+           " bytes of source")
+              .str();
+    return Read::Malformed;
+  }
+  args.assign(nargs, {});
+  for (std::string &arg : args)
+    if (Read r = readLine(arg, maxArgLen); r != Read::Ok) {
+      err = r == Read::End ? "truncated request" : "argument too long";
+      return r;
+    }
+  source.resize(len);
+  if (fread(source.data(), 1, len, stdin) != len) {
+    err = "truncated request";
+    return Read::End;
+  }
+  return Read::Ok;
+}
+
+static void respond(StringRef status, StringRef body) {
+  fprintf(stdout, "%s %zu\n", status.str().c_str(), body.size());
+  fwrite(body.data(), 1, body.size(), stdout);
+  fflush(stdout);
+}
+
+static void respond(Expected<std::string> res) {
+  if (res)
+    respond("ok", *res);
+  else
+    respond("error", toString(res.takeError()));
+}
+
+int serve(const char *argv0, ArrayRef<std::string> defaultArgs,
+          const minic::Options &serveOpts) {
+  FileCache cache;
+  auto fs = createCachingFileSystem(cache, vfs::getRealFileSystem());
+  minic::Options opts = serveOpts;
+  opts.fs = fs;
+  // Driver output per distinct command line; the driver is not cheap.
+  StringMap<std::unique_ptr<CompilerInvocation>> invocations;
+
+  std::vector<std::string> reqArgs;
+  std::string source, err;
+  // After a malformed request, lines are skipped up to the next valid
+  // header, with one error for them all.
+  bool synced = true;
+  for (;;) {
+    Read r = readRequest(reqArgs, source, err);
+    if (r == Read::End) {
+      if (!err.empty())
+        respond("error", err);
+      break;
+    }
+    if (r == Read::Malformed) {
+      if (synced)
+        respond("error", err);
+      synced = false;
+      continue;
+    }
+    synced = true;
+    // Neither the flags nor the file matter without a parse.
+    if (opts.lexicalOnly) {
+      respond(minic::minify(source, {argv0}, opts));
+      continue;
+    }
+    // Headers may have been edited since the last request. Each request gets
+    // a fresh FileManager, which keeps its own stats, on top of the cache.
+    cache.expire();
+    std::string key = join(reqArgs, StringRef("\0", 1));
+    auto &cached = invocations[key];
+    if (!cached) {
+      std::vector<const char *> args{argv0};
+      for (const std::string &arg : defaultArgs)
+        args.push_back(arg.c_str());
+      for (const std::string &arg : reqArgs)
+        args.push_back(arg.c_str());
+      cached = buildCompilerInvocation(args, fs);
+      if (!cached) {
+        invocations.erase(key);
+        respond("error", "failed to build CompilerInvocation");
+        continue;
+      }
+    }
+
+    auto ci = std::make_unique<CompilerInvocation>(*cached);
+    StringRef file = ci->getFrontendOpts().Inputs[0].getFile();
+    // source outlives the request, so the remapped buffer just points at it.
+    ci->getPreprocessorOpts().addRemappedFile(
+        file, MemoryBuffer::getMemBuffer(source, file).release());
+    respond(minifyInvocation(std::move(ci), opts));
+  }
+  return ferror(stdin) ? 1 : 0;
+}
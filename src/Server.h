@@ -0,0 +1,31 @@
+#pragma once
+
+#include "common.h"
+#include "minic.h"
+
+/*
+ * minic --serve: answer minification requests on stdin/stdout until EOF,
+ * keeping the header stat/content cache, the driver output for each
+ * distinct command line and the precompiled preambles alive between
+ * requests. A request stats a cached header again the first time it uses
+ * it, so edits are seen without a restart, and the headers a request does
+ * not use cost it nothing.
+ *
+ * Request:   <nargs> <srclen>\n
+ *            <arg>\n                 (nargs times; clang flags and one file)
+ *            <srclen bytes of source>
+ * Response:  ok <len>\n<len bytes of minified source>
+ *            error <len>\n<len bytes of message>
+ *
+ * A request of more than 4096 arguments, an argument over 64 KiB or a
+ * source over 1 GiB, or a header that is not two numbers, gets an error and
+ * the lines after it are skipped up to the next valid header. A request cut
+ * short by EOF gets an error too.
+ *
+ * The file named in the request need not exist; its directory is used to
+ * resolve quoted includes and its extension (or -x) selects the language.
+ * With opts.lexicalOnly, the source is only stripped of comments and
+ * whitespace, and the arguments are ignored.
+ */
+int serve(const char *argv0, ArrayRef<std::string> defaultArgs,
+          const minic::Options &opts);
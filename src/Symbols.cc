@@ -0,0 +1,40 @@
+#include "Symbols.h"
+
+static int digitValue(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'A' && c <= 'Z')
+    return c - 'A' + 10;
+  if (c >= 'a' && c <= 'z')
+    return c - 'a' + 36;
+  return -1;
+}
+
+void ReservedNames::insert(StringRef name) {
+  count++;
+  // Ten digits still fit in 64 bits; no counter gets anywhere near that.
+  if (name.empty() || name.size() > 11 || letterIndex(name[0]) < 0)
+    return;
+  // The most significant digit of a new name is never 0.
+  if (name.size() > 1 && name.back() == '0')
+    return;
+  uint64_t number = 0, scale = 1;
+  for (char c : name.drop_front()) {
+    int d = digitValue(c);
+    if (d < 0)
+      return;
+    number += d * scale;
+    scale *= 62;
+  }
+  shaped.push_back({uint8_t(letterIndex(name[0])), number});
+}
+
+void ReservedNames::build(uint64_t limit) {
+  this->limit = limit;
+  bits.clear();
+  bits.resize(52 * limit);
+  for (auto [letter, number] : shaped)
+    if (number < limit)
+      bits.set(letter * limit + number);
+  shaped = {};
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "common.h"
+
+enum class SymbolKind : uint8_t {
+  Function,
+  Variable,
+  Field,
+  Type,
+  EnumConstant
+};
+
+struct Symbol {
+  // The canonical decl.
+  Decl *decl;
+  // The new name, in MiniContext::saver.
+  StringRef name;
+  // For a local variable or a parameter, the block it is renamed in.
+  const CompoundStmt *scope;
+  SymbolKind kind;
+};
+
+/*
+ * The decls to rename, numbered densely in the order they were found. A
+ * Rename refers to its symbol by that number, and everything known about a
+ * symbol sits in one vector entry.
+ */
+class SymbolTable {
+  std::vector<Symbol> symbols;
+  DenseMap<const Decl *, unsigned> ids;
+
+public:
+  // The symbol of d, added with kind if d has none yet.
+  Symbol &get(Decl *d, SymbolKind kind) {
+    auto [it, inserted] = ids.try_emplace(d, symbols.size());
+    if (inserted)
+      symbols.push_back({d, {}, nullptr, kind});
+    return symbols[it->second];
+  }
+  // The number of d's symbol, or -1.
+  int find(const Decl *d) const {
+    auto it = ids.find(d);
+    return it == ids.end() ? -1 : int(it->second);
+  }
+  Symbol &operator[](unsigned id) { return symbols[id]; }
+  const Symbol &operator[](unsigned id) const { return symbols[id]; }
+  unsigned size() const { return symbols.size(); }
+  auto begin() { return symbols.begin(); }
+  auto end() { return symbols.end(); }
+};
+
+/*
+ * The identifiers new names must avoid. New names are a letter followed by
+ * the base-62 digits of a number, least significant first (see
+ * MiniASTConsumer::nextName), so only identifiers of that shape are kept,
+ * as that letter and number, and looked up in a bitset instead of hashing
+ * the candidate name.
+ */
+class ReservedNames {
+  std::vector<std::pair<uint8_t, uint64_t>> shaped;
+  BitVector bits;
+  uint64_t limit = 0;
+  size_t count = 0;
+
+  static int letterIndex(char c) {
+    if (c >= 'A' && c <= 'Z')
+      return c - 'A';
+    if (c >= 'a' && c <= 'z')
+      return c - 'a' + 26;
+    return -1;
+  }
+
+public:
+  void insert(StringRef name);
+  // Index the names inserted so far. Only numbers below limit are looked up.
+  void build(uint64_t limit);
+  bool contains(char letter, uint64_t number) const {
+    assert(number < limit && "number past the limit given to build");
+    return bits.test(letterIndex(letter) * limit + number);
+  }
+  // Identifiers inserted, and those of them a new name could spell (until
+  // build, which drops them).
+  size_t size() const { return count; }
+  size_t candidates() const { return shaped.size(); }
+};
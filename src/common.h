@@ -8,8 +8,7 @@
 #include <clang/AST/DeclTemplate.h>
 #include <clang/AST/Expr.h>
 #include <clang/AST/ExprCXX.h>
-#include <clang/AST/ParentMap.h>
-#include <clang/AST/ParentMapContext.h>
+#include <clang/AST/Mangle.h>
 #include <clang/AST/RecursiveASTVisitor.h>
 #include <clang/AST/Stmt.h>
 #include <clang/AST/Type.h>
@@ -19,6 +18,7 @@
 #include <clang/Basic/LangOptions.h>
 #include <clang/Basic/SourceManager.h>
 #include <clang/Basic/TargetInfo.h>
+#include <clang/Basic/Version.h>
 #include <clang/Driver/Action.h>
 #include <clang/Driver/Compilation.h>
 #include <clang/Driver/Driver.h>
@@ -26,48 +26,51 @@
 #include <clang/Format/Format.h>
 #include <clang/Frontend/CompilerInstance.h>
 #include <clang/Frontend/FrontendAction.h>
+#include <clang/Frontend/FrontendActions.h>
+#include <clang/Frontend/PrecompiledPreamble.h>
+#include <clang/Frontend/Utils.h>
 #include <clang/Lex/Lexer.h>
+#include <clang/Lex/MacroInfo.h>
+#include <clang/Lex/PPCallbacks.h>
+#include <clang/Lex/Preprocessor.h>
 #include <clang/Lex/PreprocessorOptions.h>
 #include <clang/Tooling/Core/Replacement.h>
+#include <clang/Tooling/JSONCompilationDatabase.h>
+#include <llvm/ADT/BitVector.h>
 #include <llvm/ADT/CachedHashString.h>
 #include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/Hashing.h>
 #include <llvm/ADT/MapVector.h>
 #include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringSet.h>
 #include <llvm/Config/llvm-config.h>
+#include <llvm/Support/Allocator.h>
+#include <llvm/Support/BLAKE3.h>
 #include <llvm/Support/Casting.h>
+#include <llvm/Support/FormatVariadic.h>
 #if LLVM_VERSION_MAJOR >= 16
 #include <llvm/TargetParser/Host.h>
 #else
 #include <llvm/Support/Host.h>
 #endif
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/Path.h>
+#include <llvm/Support/StringSaver.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <mutex>
+#include <numeric>
+#include <queue>
 
 using namespace clang;
 using namespace llvm;
 
-typedef struct {
-  std::string name;
-  size_t type_hash;
-  const CompoundStmt *c;
-} DeclMapData;
-
-typedef struct {
-  SmallVector<Decl *> d;
-  int id;
-} CompoundStmtMapData;
-
-/*
- * Retrive n's parent node in the ASTContext.
- * Return a pointer to the first-found parent with type T1,
- * otherwise a nullptr.
- */
-template <typename T1, typename T2>
-const T1 *getParent(ASTContext &ctx, const T2 &n) {
-  DynTypedNode dyn = DynTypedNode::create(n);
-  const auto &parents = ctx.getParents(dyn);
-  for (auto &p : parents) {
-    if (auto *tp = p.get<T1>())
-      return tp;
-  }
-  return nullptr;
-}
\ No newline at end of file
+#if LLVM_VERSION_MAJOR >= 19
+using MiniThreadPool = DefaultThreadPool;
+#else
+using MiniThreadPool = ThreadPool;
+#endif
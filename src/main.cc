@@ -1,169 +1,200 @@
+#include <atomic>
 #include <err.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <memory>
 #include <unistd.h>
 
-#include "Collector.h"
-#include "Renamer.h"
+#include "FileCache.h"
+#include "Minifier.h"
+#include "OutputCache.h"
+#include "Server.h"
 #include "common.h"
-#include "postProcess.h"
-
-SmallVector<StringRef, 0> ignores;
-MapVector<Decl *, DeclMapData> d2name;
-MapVector<const CompoundStmt *, CompoundStmtMapData> c2d;
-DenseSet<CachedHashStringRef> used;
-
-std::string newCode;
-int LocalIDMax;
-
-namespace clang {
-std::unique_ptr<CompilerInvocation>
-buildCompilerInvocation(ArrayRef<const char *> args) {
-  IntrusiveRefCntPtr<DiagnosticsEngine> diags(
-      CompilerInstance::createDiagnostics(new DiagnosticOptions,
-                                          new IgnoringDiagConsumer, true));
-
-  driver::Driver d(args[0], llvm::sys::getDefaultTargetTriple(), *diags,
-                   "minic", llvm::vfs::getRealFileSystem());
-  d.setCheckInputsExist(false);
-  std::unique_ptr<driver::Compilation> comp(d.BuildCompilation(args));
-  if (!comp)
-    return nullptr;
-  const driver::JobList &jobs = comp->getJobs();
-  if (jobs.size() != 1 || !isa<driver::Command>(*jobs.begin()))
-    return nullptr;
-
-  const driver::Command &cmd = cast<driver::Command>(*jobs.begin());
-  if (StringRef(cmd.getCreator().getName()) != "clang")
-    return nullptr;
-  const llvm::opt::ArgStringList &cc_args = cmd.getArguments();
-  auto ci = std::make_unique<CompilerInvocation>();
-  if (!CompilerInvocation::CreateFromArgs(*ci, cc_args, *diags))
-    return nullptr;
-
-  ci->getDiagnosticOpts().IgnoreWarnings = true;
-  ci->getFrontendOpts().DisableFree = false;
-  return ci;
+#include "minic.h"
+
+namespace {
+struct Job {
+  std::string input;
+  std::vector<std::string> args;
+  std::string output;
+  uint64_t size = 0;
+};
+} // namespace
+
+// Write code to os, through a large buffer when there is a lot of it: few
+// write(2)s, each big enough to amortize the syscall and the round trip on
+// network file systems.
+static void writeLarge(raw_fd_ostream &os, StringRef code) {
+  const size_t bufferSize = 8 << 20;
+  if (code.size() > bufferSize)
+    os.SetBufferSize(bufferSize);
+  os << code;
 }
 
-struct MiniASTConsumer : ASTConsumer {
-  ASTContext *ctx;
-  int n_fn = 0, n_var = 0, n_fld = 0, n_type = 0, n_enumconst = 0;
-
-  void Initialize(ASTContext &ctx) override { this->ctx = &ctx; }
-  static std::string getName(StringRef origName, StringRef prefix, int &id) {
-    static const char digits[] =
-        "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
-    std::string newName;
-    int old_n = id;
-    for (;;) {
-      newName = std::string(1, prefix[id % prefix.size()]);
-      if (int i = id / prefix.size())
-        while (newName += digits[i % 62], i /= 62)
-          ;
-      id++;
-      if (!used.contains(CachedHashStringRef(newName)))
-        break;
-    }
-    if (newName.size() >= origName.size()) {
-      newName = origName;
-      id = old_n;
+// Sync the directory dir, so that a rename in it survives a crash; on NFS
+// and others, the new entry may otherwise be lost along with the old file's
+// replacement. File systems that cannot sync a directory say EINVAL.
+static std::error_code syncDir(StringRef dir) {
+  int fd = open(dir.empty() ? "." : dir.str().c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0)
+    return std::error_code(errno, std::generic_category());
+  std::error_code ec;
+  if (fsync(fd) && errno != EINVAL)
+    ec = std::error_code(errno, std::generic_category());
+  close(fd);
+  return ec;
+}
+
+static bool writeOutput(StringRef path, StringRef code) {
+  auto fail = [&](std::error_code ec) {
+    warnx("%s: %s", path.str().c_str(), ec.message().c_str());
+    return false;
+  };
+  sys::fs::file_status st;
+  bool toStdout = path == "-";
+  bool exists = !toStdout && !sys::fs::status(path, st);
+  // Standard output ("-") and devices such as /dev/null are written directly.
+  if (toStdout || (exists && st.type() != sys::fs::file_type::regular_file)) {
+    std::error_code ec;
+    raw_fd_ostream os(path, ec, sys::fs::OF_None);
+    if (ec)
+      return fail(ec);
+    writeLarge(os, code);
+    os.close();
+    if (os.has_error()) {
+      ec = os.error();
+      os.clear_error();
+      return fail(ec);
     }
-    return newName;
-  }
-  bool HandleTopLevelDecl(DeclGroupRef dgr) override {
-    for (auto s : {"j0", "j1", "jn", "j0f", "j1f", "jnf", "j0l", "j1l", "jnl"})
-      used.insert(CachedHashStringRef(s));
-    for (auto s : {"y0", "y1", "yn", "y0f", "y1f", "ynf", "y0l", "y1l", "ynl"})
-      used.insert(CachedHashStringRef(s));
     return true;
   }
-  void HandleTranslationUnit(ASTContext &ctx) override {
-    Collector c(ctx);
-    c.TraverseDecl(ctx.getTranslationUnitDecl());
-    for (auto &[d, v] : d2name) {
-      std::string vName =
-          dynamic_cast<NamedDecl *>(d)->getDeclName().getAsString();
-#ifndef NDEBUG
-      errs() << "type_hash: " << v.type_hash << ", renaming from " << vName;
-#endif
-      if (v.type_hash == typeid(FunctionDecl *).hash_code())
-        v.name = getName(vName, "abcdefghijklm", n_fn);
-      else if (v.type_hash == typeid(VarDecl *).hash_code()) {
-        if (auto it = c2d.find(v.c); it != c2d.end()) {
-          int &id = it->second.id;
-          v.name = getName(vName, "rstuvwxyz", id);
-        } else
-          // global variables, should not share w/ local
-          v.name = getName(vName, "nopq", n_var);
-      } else if (v.type_hash == typeid(FieldDecl *).hash_code()) {
-        v.name = getName(vName, "nopqrstuvwxyz", n_fld);
-      } else if (v.type_hash == typeid(TypeDecl *).hash_code()) {
-        v.name = getName(vName, "ABCDEFGHIJKLM", n_type);
-      } else if (v.type_hash == typeid(EnumConstantDecl *).hash_code()) {
-        v.name = getName(vName, "NOPQRSTUVWXYZ", n_enumconst);
-      }
-#ifndef NDEBUG
-      errs() << " to " << v.name << "\n";
-#endif
+
+  // Anything else goes to a temporary file next to path (or next to the file
+  // a symlink points to), which is synced and renamed over it, and then the
+  // directory is synced: a crash leaves either the old file or the new one,
+  // never a truncated input.
+  SmallString<256> target(path), tmp;
+  if (exists)
+    sys::fs::real_path(path, target);
+  int fd;
+  if (std::error_code ec = sys::fs::createUniqueFile(
+          target + ".minic-%%%%%%", fd, tmp, sys::fs::OF_None,
+          exists ? st.permissions() : sys::fs::all_read | sys::fs::all_write))
+    return fail(ec);
+  if (exists)
+    sys::fs::setPermissions(tmp, st.permissions());
+  std::error_code ec;
+  {
+    raw_fd_ostream os(fd, false);
+    writeLarge(os, code);
+    os.flush();
+    if (os.has_error()) {
+      ec = os.error();
+      os.clear_error();
     }
-    tooling::Replacements reps;
-    Renamer r(ctx, reps);
-    r.TraverseDecl(ctx.getTranslationUnitDecl());
-    auto &sm = ctx.getSourceManager();
-    StringRef code = sm.getBufferData(sm.getMainFileID());
-    auto res = tooling::applyAllReplacements(code, reps);
-    if (!res)
-      errx(2, "failed to apply replacements: %s",
-           toString(res.takeError()).c_str());
-    newCode = *res;
   }
-};
-
-struct MiniAction : ASTFrontendAction {
-  std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &ci,
-                                                 StringRef inFile) override {
-    return std::make_unique<MiniASTConsumer>();
+  if (!ec && fsync(fd))
+    ec = std::error_code(errno, std::generic_category());
+  close(fd);
+  if (!ec)
+    ec = sys::fs::rename(tmp, target);
+  if (ec) {
+    sys::fs::remove(tmp);
+    return fail(ec);
   }
-};
+  if ((ec = syncDir(sys::path::parent_path(target))))
+    return fail(ec);
+  return true;
+}
 
-void reformat() {
-  auto buf = MemoryBuffer::getMemBuffer(newCode, "", true);
-  format::FormatStyle style =
-      cantFail(format::getStyle("LLVM", "-", "LLVM", newCode, nullptr));
-  style.ColumnLimit = 9999;
-  style.IndentWidth = 0;
-  style.ContinuationIndentWidth = 0;
-  style.SpaceBeforeAssignmentOperators = false;
-  style.SpaceBeforeParens = format::FormatStyle::SBPO_Never;
-  style.AlignEscapedNewlines = format::FormatStyle::ENAS_DontAlign;
-
-  format::FormattingAttemptStatus status;
-  std::vector<tooling::Range> ranges{{0, unsigned(newCode.size())}};
-  tooling::Replacements reps =
-      format::reformat(style, newCode, ranges, "-", &status);
-  auto res = tooling::applyAllReplacements(newCode, reps);
-  if (!res)
-    errx(2, "failed to apply replacements: %s",
-         toString(res.takeError()).c_str());
-  newCode = *res;
+static void printStats(const minic::Timings &t, const minic::Stats &s) {
+  fprintf(stderr,
+          "minic: ms: driver %.1f, parse %.1f, collect %.1f, names %.1f, "
+          "rename %.1f, apply %.1f, reformat %.1f, postprocess %.1f\n",
+          t.driver * 1e3, t.parse * 1e3, t.collect * 1e3, t.names * 1e3,
+          t.rename * 1e3, t.apply * 1e3, t.reformat * 1e3,
+          t.postProcess * 1e3);
+  fprintf(stderr,
+          "minic: renamed %llu functions, %llu variables, %llu fields, %llu "
+          "types, %llu enum constants in %llu scopes\n",
+          (unsigned long long)s.functions, (unsigned long long)s.variables,
+          (unsigned long long)s.fields, (unsigned long long)s.types,
+          (unsigned long long)s.enumConstants, (unsigned long long)s.scopes);
+  fprintf(stderr, "minic: %llu used names, %llu renames\n",
+          (unsigned long long)s.usedNames, (unsigned long long)s.renames);
+  fprintf(stderr,
+          "minic: naming by reference count saved %lld bytes over "
+          "declaration order\n",
+          (long long)s.weightingSavedBytes);
+  if (s.includesRemoved)
+    fprintf(stderr,
+            "minic: removed %llu includes, up to %llu bytes of headers\n",
+            (unsigned long long)s.includesRemoved,
+            (unsigned long long)s.includeBytesRemoved);
+  if (s.deadDecls)
+    fprintf(stderr, "minic: stripped %llu dead decls, %llu bytes\n",
+            (unsigned long long)s.deadDecls, (unsigned long long)s.deadBytes);
+  fprintf(stderr,
+          "minic: bytes: %llu in, %llu renamed, %llu reformatted, %llu out\n",
+          (unsigned long long)s.inputBytes, (unsigned long long)s.renamedBytes,
+          (unsigned long long)s.reformattedBytes,
+          (unsigned long long)s.outputBytes);
+  fprintf(stderr, "minic: peak memory: %llu KiB names, %llu KiB AST\n",
+          (unsigned long long)s.arenaBytes / 1024,
+          (unsigned long long)s.astBytes / 1024);
 }
-} // namespace clang
 
 int main(int argc, char *argv[]) {
-  std::vector<const char *> args{argv[0], "-fsyntax-only",
-                                 "-I/usr/lib/clang/18/include"};
-  bool inplace = false;
-  const char *outfile = "/dev/stdout";
-  const char usage[] = R"(Usage: %s [-i] [-f fun]... a.c
+  const std::vector<std::string> defaultArgs{"-fsyntax-only",
+                                             "-I/usr/lib/clang/18/include"};
+  SmallVector<StringRef, 0> ignores;
+  std::vector<std::string> inputs, extraArgs;
+  bool inplace = false, serveMode = false, reformat = false, stats = false;
+  bool lexicalOnly = false, pruneIncludes = false, stripDead = false;
+  const char *outfile = nullptr, *compdb = nullptr, *pchDir = nullptr;
+  const char *cacheDir = nullptr, *traceFile = nullptr, *lang = nullptr;
+  // Spans shorter than this many microseconds are left out, as in clang.
+  const unsigned traceGranularity = 500;
+  unsigned jobs = 0;
+  const char usage[] =
+      R"(Usage: %s [-i] [-f fun]... [-j N] a.c... [-- clang-args]
+       %s [-o out] [-f fun]... -x lang - [-- clang-args]
+       %s [-i | -o dir] [-f fun]... [-j N] -p compile_commands.json
+       %s [-f fun]... --serve
 
 Options:
--i      edit a.c in place\n)";
+-       read the source from stdin (needs -x) and write it to stdout or -o
+-i      edit the inputs in place
+-o      output file (one input) or output directory (several inputs)
+-x lang treat the inputs as lang (c, c++, ...), as clang -x
+-f      keep the name of function fun
+-j N    minify up to N files at once (default: all cores)
+-p      minify every entry of a compilation database
+--serve answer requests on stdin until EOF (protocol in src/Server.h)
+--pch-cache dir
+        reuse precompiled preambles stored in dir (--serve: a temp dir)
+--cache-dir dir
+        reuse the outputs of unchanged inputs stored in dir
+--reformat
+        run clang-format before stripping whitespace (slower; to cross-check
+        the output)
+--lexical-only
+        only strip comments and whitespace; no parse, no renaming
+--prune-includes
+        remove the #include lines nothing in the input depends on
+--strip-dead
+        remove the static functions and variables, typedefs and tags that
+        nothing reaches from main, -f functions and external symbols
+--stats print time per phase, counters and sizes to stderr on exit
+--time-trace=file
+        write a Chrome trace of every phase (and of clang's) to file
+)";
   for (int i = 1; i < argc; i++) {
     StringRef opt(argv[i]);
-    if (opt[0] != '-')
-      args.push_back(argv[i]);
+    if (opt[0] != '-' || opt == "-")
+      inputs.push_back(argv[i]);
     else if (opt == "-h") {
-      fputs(usage, stdout);
+      printf(usage, argv[0], argv[0], argv[0], argv[0]);
       return 0;
     } else if (opt == "-i")
       inplace = true;
@@ -171,49 +202,280 @@ Options:
       ignores.push_back(argv[++i]);
     else if (opt == "-o" && i + 1 < argc)
       outfile = argv[++i];
-    else {
-      fputs(usage, stderr);
+    else if (opt == "-x" && i + 1 < argc)
+      lang = argv[++i];
+    else if (opt == "--serve")
+      serveMode = true;
+    else if (opt == "--pch-cache" && i + 1 < argc)
+      pchDir = argv[++i];
+    else if (opt == "--reformat")
+      reformat = true;
+    else if (opt == "--lexical-only")
+      lexicalOnly = true;
+    else if (opt == "--prune-includes")
+      pruneIncludes = true;
+    else if (opt == "--strip-dead")
+      stripDead = true;
+    else if (opt == "--stats")
+      stats = true;
+    else if (opt.consume_front("--time-trace="))
+      traceFile = opt.data();
+    else if (opt == "--cache-dir" && i + 1 < argc)
+      cacheDir = argv[++i];
+    else if (opt == "-p" && i + 1 < argc)
+      compdb = argv[++i];
+    else if ((opt == "-j" || opt == "--jobs") && i + 1 < argc &&
+             !StringRef(argv[i + 1]).getAsInteger(10, jobs))
+      i++;
+    else if (opt == "--") {
+      extraArgs.assign(argv + i + 1, argv + argc);
+      break;
+    } else {
+      fprintf(stderr, usage, argv[0], argv[0], argv[0], argv[0]);
       return 1;
     }
   }
 
-  if (argc < 2) {
-    fputs(usage, stderr);
+  if (lexicalOnly && (pruneIncludes || stripDead))
+    errx(1, "%s needs a parse; drop --lexical-only",
+         pruneIncludes ? "--prune-includes" : "--strip-dead");
+  ignores.push_back("main");
+  if (traceFile)
+    timeTraceProfilerInitialize(traceGranularity, argv[0]);
+  minic::Timings timings;
+  minic::Stats counters;
+  std::mutex statsMu;
+  auto finish = [&](int status) {
+    if (stats)
+      printStats(timings, counters);
+    if (traceFile) {
+      if (Error e = timeTraceProfilerWrite(traceFile, "minic"))
+        warnx("%s: %s", traceFile, toString(std::move(e)).c_str());
+      timeTraceProfilerCleanup();
+    }
+    return status;
+  };
+
+  SmallString<256> pchPath;
+  if (pchDir)
+    pchPath = pchDir;
+  else if (serveMode) {
+    sys::path::system_temp_directory(true, pchPath);
+    sys::path::append(pchPath, "minic-pch");
+  }
+  std::shared_ptr<PreambleCache> preambles;
+  if (!pchPath.empty()) {
+    if (std::error_code ec = sys::fs::create_directories(pchPath))
+      errx(1, "%s: %s", pchPath.c_str(), ec.message().c_str());
+    preambles = minic::makePreambleCache(pchPath);
+  }
+  minic::Options opts;
+  opts.ignores = ignores;
+  opts.preambles = preambles.get();
+  opts.reformat = reformat;
+  opts.lexicalOnly = lexicalOnly;
+  opts.pruneIncludes = pruneIncludes;
+  opts.stripDead = stripDead;
+  if (serveMode) {
+    if (stats) {
+      opts.timings = &timings;
+      opts.stats = &counters;
+    }
+    return finish(serve(argv[0], defaultArgs, opts));
+  }
+
+  if (inputs.empty() && !compdb) {
+    fprintf(stderr, usage, argv[0], argv[0], argv[0], argv[0]);
     return 1;
   }
 
-  ignores.push_back("main");
+  // Standard input is parsed as a file "<stdin>" in the working directory
+  // (so that #include "x.h" finds the same headers as for a file there)
+  // which exists only in memory.
+  bool readStdin = llvm::is_contained(inputs, "-");
+  SmallString<256> stdinPath;
+  if (readStdin) {
+    if (inputs.size() > 1 || compdb || inplace)
+      errx(1, "- cannot be combined with other inputs, -p or -i");
+    if (!lang && !lexicalOnly && !llvm::is_contained(extraArgs, "-x"))
+      errx(1, "- needs -x lang");
+    sys::fs::current_path(stdinPath);
+    sys::path::append(stdinPath, "<stdin>");
+  }
 
-  auto ci = buildCompilerInvocation(args);
-  if (!ci)
-    errx(1, "failed to build CompilerInvocation");
-
-  auto inst = std::make_unique<CompilerInstance>(
-      std::make_shared<PCHContainerOperations>());
-  IgnoringDiagConsumer dc;
-  inst->setInvocation(std::move(ci));
-  inst->createDiagnostics(&dc, false);
-  inst->getDiagnostics().setIgnoreAllWarnings(true);
-  inst->setTarget(TargetInfo::CreateTargetInfo(
-      inst->getDiagnostics(), inst->getInvocation().TargetOpts));
-  if (!inst->hasTarget())
-    errx(1, "hasTarget returns false");
-  inst->createFileManager(llvm::vfs::getRealFileSystem());
-  inst->setSourceManager(
-      new SourceManager(inst->getDiagnostics(), inst->getFileManager(), true));
-
-  MiniAction action;
-  if (!action.BeginSourceFile(*inst, inst->getFrontendOpts().Inputs[0]))
-    errx(2, "failed to parse");
-  if (Error e = action.Execute())
-    errx(2, "failed to execute");
-  action.EndSourceFile();
-  reformat();
-  postProcess(newCode);
+  std::vector<Job> work;
+  for (const std::string &input : inputs) {
+    Job job;
+    job.input = input;
+    job.args = defaultArgs;
+    if (lang)
+      job.args.insert(job.args.end(), {"-x", lang});
+    job.args.insert(job.args.end(), extraArgs.begin(), extraArgs.end());
+    job.args.push_back(input == "-" ? std::string(stdinPath) : input);
+    work.push_back(std::move(job));
+  }
+  if (compdb) {
+    TimeTraceScope scope("LoadCompilationDatabase", compdb);
+    std::string err;
+    auto db = tooling::JSONCompilationDatabase::loadFromFile(
+        compdb, err, tooling::JSONCommandLineSyntax::AutoDetect);
+    if (!db)
+      errx(1, "%s", err.c_str());
+    for (tooling::CompileCommand &cmd : db->getAllCompileCommands()) {
+      Job job;
+      SmallString<256> path(cmd.Filename);
+      sys::fs::make_absolute(cmd.Directory, path);
+      job.input = std::string(path);
+      if (cmd.CommandLine.empty()) {
+        warnx("%s: empty command line in %s, skipped", job.input.c_str(),
+              compdb);
+        continue;
+      }
+      // Drop the compiler name; the driver is always ours.
+      job.args.assign(cmd.CommandLine.begin() + 1, cmd.CommandLine.end());
+      job.args.insert(job.args.end(), defaultArgs.begin(), defaultArgs.end());
+      job.args.insert(job.args.end(), {"-working-directory", cmd.Directory});
+      work.push_back(std::move(job));
+    }
+  }
 
-  std::error_code ec;
-  raw_fd_ostream(inplace ? inst->getFrontendOpts().Inputs[0].getFile()
-                         : outfile,
-                 ec, sys::fs::OF_None)
-      << newCode;
-}
\ No newline at end of file
+  bool batch = work.size() > 1 || compdb;
+  if (batch && !inplace && !outfile)
+    errx(1, "several inputs need -i or -o dir");
+  for (Job &job : work) {
+    if (inplace)
+      job.output = job.input;
+    else if (!batch)
+      job.output = outfile ? outfile : "-";
+    else {
+      // Mirror the input path below the output directory.
+      SmallString<256> abs(job.input), out(outfile);
+      sys::fs::make_absolute(abs);
+      sys::path::append(out, sys::path::relative_path(abs));
+      job.output = std::string(out);
+    }
+    sys::fs::file_size(job.input, job.size);
+  }
+  // A file listed twice (a compilation database entry per configuration) is
+  // minified once, with its first command line: two jobs would write the
+  // same output at the same time.
+  StringSet<> seenInputs, seenOutputs;
+  llvm::erase_if(work, [&](const Job &job) {
+    bool newInput = seenInputs.insert(job.input).second;
+    bool newOutput = seenOutputs.insert(job.output).second;
+    if (newInput && newOutput)
+      return false;
+    warnx("%s: listed more than once, minified once", job.input.c_str());
+    return true;
+  });
+
+  FileCache cache;
+  for (const Job &job : work)
+    cache.addUncached(job.input);
+  IntrusiveRefCntPtr<vfs::FileSystem> cachingFs =
+      createCachingFileSystem(cache, vfs::getRealFileSystem());
+  std::unique_ptr<OutputCache> outputs;
+  if (cacheDir) {
+    if (std::error_code ec = sys::fs::create_directories(cacheDir))
+      errx(1, "%s: %s", cacheDir, ec.message().c_str());
+    outputs = std::make_unique<OutputCache>(cacheDir);
+  }
+
+  std::atomic<int> failed{0};
+  // Minify one job with opts; false if it failed.
+  auto minifyJob = [&](const Job &job, minic::Options jobOpts) {
+    if (batch && !inplace)
+      sys::fs::create_directories(sys::path::parent_path(job.output));
+    // Large inputs are mapped rather than read; "-" reads stdin whole.
+    auto buf = MemoryBuffer::getFileOrSTDIN(job.input);
+    if (!buf) {
+      warnx("%s: %s", job.input.c_str(), buf.getError().message().c_str());
+      return false;
+    }
+    IntrusiveRefCntPtr<vfs::FileSystem> fs = cachingFs;
+    if (job.input == "-") {
+      auto mem = makeIntrusiveRefCnt<vfs::InMemoryFileSystem>();
+      mem->addFileNoOwn(stdinPath, 0, (*buf)->getMemBufferRef());
+      auto overlay = makeIntrusiveRefCnt<vfs::OverlayFileSystem>(fs);
+      overlay->pushOverlay(mem);
+      fs = overlay;
+    }
+    StringRef code = (*buf)->getBuffer();
+    std::string key;
+    if (outputs) {
+      TimeTraceScope scope("OutputCacheLookup");
+      key = OutputCache::key(code, job.args, opts);
+      std::string hit = outputs->lookup(key, *fs);
+      if (!hit.empty() && copyCached(hit, job.output, !inplace))
+        return true;
+    }
+
+    std::vector<const char *> args{argv[0]};
+    for (const std::string &arg : job.args)
+      args.push_back(arg.c_str());
+    std::vector<std::string> deps;
+    jobOpts.fs = fs;
+    jobOpts.deps = outputs ? &deps : nullptr;
+    auto res = minic::minify(**buf, args, jobOpts);
+    if (!res) {
+      warnx("%s: %s", job.input.c_str(), toString(res.takeError()).c_str());
+      return false;
+    }
+    TimeTraceScope scope("WriteOutput", job.output);
+    if (!writeOutput(job.output, *res))
+      return false;
+    if (!key.empty())
+      outputs->store(key, deps, *res, *fs);
+    return true;
+  };
+  auto run = [&](const Job &job) {
+    // Each worker thread traces into a profiler of its own, handed back after
+    // every job so that timeTraceProfilerWrite can merge them all.
+    bool ownTrace = traceFile && !timeTraceProfilerEnabled();
+    if (ownTrace)
+      timeTraceProfilerInitialize(traceGranularity, argv[0]);
+    minic::Timings jobTimings;
+    minic::Stats jobStats;
+    minic::Options jobOpts = opts;
+    std::vector<std::string> pruned;
+    if (stats) {
+      jobOpts.timings = &jobTimings;
+      jobOpts.stats = &jobStats;
+      jobOpts.prunedIncludes = &pruned;
+    }
+    {
+      TimeTraceScope scope("Minify", job.input);
+      if (!minifyJob(job, jobOpts))
+        failed++;
+    }
+    if (stats) {
+      std::lock_guard<std::mutex> lock(statsMu);
+      timings += jobTimings;
+      counters += jobStats;
+      for (const std::string &line : pruned)
+        fprintf(stderr, "minic: %s: removed %s\n", job.input.c_str(),
+                line.c_str());
+    }
+    if (ownTrace)
+      timeTraceProfilerFinishThread();
+  };
+
+  if (work.size() == 1) {
+    // The only TU gets all the threads for its renames.
+    opts.threads = hardware_concurrency(jobs).compute_thread_count();
+    run(work[0]);
+  } else {
+    // Largest files first so that a big straggler does not start last.
+    llvm::stable_sort(work, [](const Job &a, const Job &b) {
+      return a.size > b.size;
+    });
+    MiniThreadPool pool(hardware_concurrency(jobs));
+    for (const Job &job : work)
+      pool.async([&run, &job] { run(job); });
+    pool.wait();
+  }
+  if (outputs)
+    fprintf(stderr, "minic: cache: %u hits, %u misses\n", outputs->getHits(),
+            outputs->getMisses());
+  return finish(failed ? 2 : 0);
+}
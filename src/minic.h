@@ -0,0 +1,134 @@
+#pragma once
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class PreambleCache;
+
+/*
+ * libminic: the minifier as a library. Every call keeps its state in its own
+ * context and reports failures as errors, so minify may run on several
+ * threads at once.
+ */
+namespace minic {
+// Wall-clock seconds per phase, added to (not reset) by each call.
+struct Timings {
+  double driver = 0, parse = 0, collect = 0, names = 0, rename = 0, apply = 0,
+         reformat = 0, postProcess = 0;
+
+  Timings &operator+=(const Timings &o) {
+    driver += o.driver, parse += o.parse, collect += o.collect;
+    names += o.names, rename += o.rename, apply += o.apply;
+    reformat += o.reformat, postProcess += o.postProcess;
+    return *this;
+  }
+};
+
+// What one call did, also added to by each call.
+struct Stats {
+  // Declarations renamed, by kind, and the blocks their locals live in.
+  uint64_t functions = 0, variables = 0, fields = 0, types = 0,
+           enumConstants = 0, scopes = 0;
+  // Names that new names must avoid, and identifiers renamed.
+  uint64_t usedNames = 0, renames = 0;
+  // Bytes saved by naming the most referenced decls first, against naming
+  // them in the order they were declared.
+  int64_t weightingSavedBytes = 0;
+  // #include lines removed by pruneIncludes, and the bytes of the headers
+  // they brought in (an upper bound on the preprocessed output saved).
+  uint64_t includesRemoved = 0, includeBytesRemoved = 0;
+  // Unreachable top-level decls removed by stripDead, and their bytes.
+  uint64_t deadDecls = 0, deadBytes = 0;
+  // Size of the code after each stage.
+  uint64_t inputBytes = 0, renamedBytes = 0, reformattedBytes = 0,
+           outputBytes = 0;
+  // Memory held by the name arena and by the ASTContext at their peak.
+  uint64_t arenaBytes = 0, astBytes = 0;
+
+  Stats &operator+=(const Stats &o) {
+    functions += o.functions, variables += o.variables, fields += o.fields;
+    types += o.types, enumConstants += o.enumConstants, scopes += o.scopes;
+    usedNames += o.usedNames, renames += o.renames;
+    weightingSavedBytes += o.weightingSavedBytes;
+    includesRemoved += o.includesRemoved;
+    includeBytesRemoved += o.includeBytesRemoved;
+    deadDecls += o.deadDecls, deadBytes += o.deadBytes;
+    inputBytes += o.inputBytes, renamedBytes += o.renamedBytes;
+    reformattedBytes += o.reformattedBytes, outputBytes += o.outputBytes;
+    arenaBytes = std::max(arenaBytes, o.arenaBytes);
+    astBytes = std::max(astBytes, o.astBytes);
+    return *this;
+  }
+};
+
+struct Options {
+  // Functions that keep their names (list "main" for whole programs).
+  llvm::ArrayRef<llvm::StringRef> ignores;
+  // Where headers are read from; the real file system if null. Share one
+  // caching file system between calls to read each header once.
+  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs;
+  // Reuse precompiled preambles from this cache, if set (see
+  // makePreambleCache).
+  PreambleCache *preambles = nullptr;
+  // If set, receives the absolute path of every header the input read.
+  std::vector<std::string> *deps = nullptr;
+  // Run clang-format (with only its whitespace passes) over the renamed
+  // source before stripping whitespace. Slower, and kept to cross-check
+  // postProcess, which alone already emits the minimal whitespace.
+  bool reformat = false;
+  // Only strip comments and whitespace: no parse, no renaming, and no header
+  // is opened. The output is what the full run gives minus the renames.
+  bool lexicalOnly = false;
+  // Remove the #include lines of the input that nothing in it (or in the
+  // other headers it includes) depends on. The whole TU is traversed, and
+  // opts.preambles is not used.
+  bool pruneIncludes = false;
+  // If set, receives each #include line pruneIncludes removed.
+  std::vector<std::string> *prunedIncludes = nullptr;
+  // Remove the internal functions and variables, typedefs and tags of the
+  // input that nothing reaches from its external symbols, ignores or the
+  // headers it includes after its first decl, which are traversed.
+  bool stripDead = false;
+  // Threads to find the renames of one TU with (not for C++ with a lambda in
+  // a template). Batches of files are better spread over files, one thread
+  // each; this is for a single large TU.
+  unsigned threads = 1;
+  // If set, the time spent in each phase is added to it.
+  Timings *timings = nullptr;
+  // If set, the counters of this call are added to it.
+  Stats *stats = nullptr;
+};
+
+/*
+ * A cache of precompiled preambles stored in dir, which must exist, for
+ * Options::preambles. Entries are keyed by the preamble, the command line
+ * and the clang version, and checked against the headers they were built
+ * from, so one cache may serve every call.
+ */
+std::shared_ptr<PreambleCache> makePreambleCache(llvm::StringRef dir);
+
+/*
+ * Minify code, the contents of the input file named in args. args is a
+ * complete compiler command line, starting with the program name, e.g.
+ * {"minic", "-fsyntax-only", "-Iinclude", "a.c"}; the file itself is never
+ * read.
+ */
+llvm::Expected<std::string> minify(llvm::StringRef code,
+                                   llvm::ArrayRef<const char *> args,
+                                   const Options &opts);
+
+// As above, but parses buf in place instead of copying it; buf must be
+// null-terminated and outlive the call.
+llvm::Expected<std::string> minify(const llvm::MemoryBuffer &buf,
+                                   llvm::ArrayRef<const char *> args,
+                                   const Options &opts);
+} // namespace minic
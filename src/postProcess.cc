@@ -1,107 +1,383 @@
-#include <err.h>
-#include <regex>
-#include <sstream>
+#include <algorithm>
+#include <cstring>
 #include <string>
-#include <vector>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "postProcess.h"
 
-static const std::vector<std::string> OPS = {
-    "+",  "-", "*",  "/",  "%",  "++",   "--",  "+=", "-=", "*=", "/=",
-    "%=", "=", "==", "!=", "&&", "||",   "!",   "&",  "|",  "^",  "<<",
-    ">>", "<", ">",  "<=", ">=", "<<=",  ">>=", "&=", "|=", "^=", ",",
-    "(",  ")", "{",  "}",  ";",  "else", ":",   "::", "?"};
-
-static const std::vector<std::string> ESC_OPS = {
-    "\\+",  "\\-", "\\*",  "/",    "%",    "\\+\\+", "\\-\\-", "\\+=",   "\\-=",
-    "\\*=", "/=",  "%=",   "=",    "==",   "!=",     "\\&\\&", "\\|\\|", "!",
-    "\\&",  "\\|", "\\^",  "<<",   ">>",   "<",      ">",      "<=",     ">=",
-    "<<=",  ">>=", "\\&=", "\\|=", "\\^=", ",",      "\\(",    "\\)",    "\\{",
-    "\\}",  ";",   "else", ":",    "::",   "\\?"};
-
-static void removeComments(std::string &input) {
-  std::string::size_type m = 0, n = 0;
-
-  while ((m = input.find("/*", n)) != std::string::npos) {
-    if ((n = input.find("*/", m)) == std::string::npos)
-      errx(2, "failed to parse comments");
-    input.replace(m, n + 2 - m, "");
+namespace {
+enum class TokKind { None, Ident, Number, Literal, HeaderName, Punct, Other };
+
+struct Token {
+  TokKind kind = TokKind::None;
+  size_t begin = 0, end = 0;
+};
+
+// Every C/C++ punctuator (including digraphs) longer than one character,
+// longest first so that the first hit is the maximal munch.
+const char *const PUNCTS[] = {
+    "%:%:", "...", "<<=", ">>=", "->*", "<=>", "->", "++", "--", "<<",
+    ">>",   "<=",  ">=",  "==",  "!=",  "&&",  "||", "*=", "/=", "%=",
+    "+=",   "-=",  "&=",  "^=",  "|=",  "##",  "::", ".*", "<:", ":>",
+    "<%",   "%>",  "%:"};
+} // namespace
+
+static bool isIdentChar(unsigned char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_' || c == '$' || c >= 0x80;
+}
+
+static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+/*
+ * Runs of bytes the scanner has no decision to make about (indentation, the
+ * rest of an identifier, the inside of a comment or a literal) are skipped
+ * 16 or 32 at a time with SSE2 or AVX2, whichever the compiler targets
+ * (-mavx2 or -march=native for the latter), and one at a time otherwise.
+ * Each byte class has a scalar test and a vector one; the vector one returns
+ * a bitmask of the bytes in the class.
+ */
+#ifdef __SSE2__
+static __m128i load16(const char *s) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+}
+static __m128i eq(__m128i v, char c) {
+  return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+}
+static __m128i either(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+// lo <= v <= hi, unsigned.
+static __m128i inRange(__m128i v, char lo, char hi) {
+  __m128i clamped = _mm_min_epu8(_mm_max_epu8(v, _mm_set1_epi8(lo)),
+                                 _mm_set1_epi8(hi));
+  return _mm_cmpeq_epi8(clamped, v);
+}
+// ASCII letters to lower case (and other bytes to garbage).
+static __m128i lower(__m128i v) {
+  return _mm_or_si128(v, _mm_set1_epi8(0x20));
+}
+static __m128i nonAscii(__m128i v) {
+  return _mm_cmplt_epi8(v, _mm_setzero_si128());
+}
+static unsigned bits(__m128i v) { return unsigned(_mm_movemask_epi8(v)); }
+#endif
+#ifdef __AVX2__
+static __m256i load32(const char *s) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s));
+}
+static __m256i eq(__m256i v, char c) {
+  return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+}
+static __m256i either(__m256i a, __m256i b) { return _mm256_or_si256(a, b); }
+static __m256i inRange(__m256i v, char lo, char hi) {
+  __m256i clamped = _mm256_min_epu8(_mm256_max_epu8(v, _mm256_set1_epi8(lo)),
+                                    _mm256_set1_epi8(hi));
+  return _mm256_cmpeq_epi8(clamped, v);
+}
+static __m256i lower(__m256i v) {
+  return _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+}
+static __m256i nonAscii(__m256i v) {
+  return _mm256_cmpgt_epi8(_mm256_setzero_si256(), v);
+}
+static unsigned bits(__m256i v) { return unsigned(_mm256_movemask_epi8(v)); }
+#endif
+
+template <typename V> static V anyOf(V v, char c) { return eq(v, c); }
+template <typename V, typename... Cs>
+static V anyOf(V v, char c, Cs... cs) {
+  return either(eq(v, c), anyOf(v, cs...));
+}
+
+namespace {
+// Spaces and tabs (other whitespace is rare enough for the main loop).
+struct Blank {
+  static bool test(unsigned char c) { return c == ' ' || c == '\t'; }
+  template <typename V> static unsigned mask(V v) {
+    return bits(anyOf(v, ' ', '\t'));
+  }
+};
+
+struct IdentChar {
+  static bool test(unsigned char c) { return isIdentChar(c); }
+  template <typename V> static unsigned mask(V v) {
+    V letter = inRange(lower(v), 'a', 'z');
+    return bits(either(either(letter, inRange(v, '0', '9')),
+                       either(anyOf(v, '_', '$'), nonAscii(v))));
   }
+};
 
-  n = 0;
+// Anything but the given bytes.
+template <char... Cs> struct NoneOf {
+  static bool test(unsigned char c) { return ((c != Cs) && ...); }
+  template <typename V> static unsigned mask(V v) {
+    return ~bits(anyOf(v, Cs...));
+  }
+};
+} // namespace
+
+// The first offset from i on (up to n) whose byte is not in class C.
+template <typename C> static size_t skip(const char *s, size_t i, size_t n) {
+#ifdef __AVX2__
+  for (; i + 32 <= n; i += 32)
+    if (unsigned stop = ~C::mask(load32(s + i)))
+      return i + __builtin_ctz(stop);
+#endif
+#ifdef __SSE2__
+  for (; i + 16 <= n; i += 16)
+    if (unsigned stop = ~C::mask(load16(s + i)) & 0xffff)
+      return i + __builtin_ctz(stop);
+#endif
+  while (i < n && C::test(s[i]))
+    i++;
+  return i;
+}
 
-  // ensure a newline to the end of the file to handle comments in the last line
-  input.push_back('\n');
-  while ((m = input.find("//", n)) != std::string::npos) {
-    if ((n = input.find("\n", m)) == std::string::npos)
-      errx(2, "failed to parse comments");
-    input.replace(m, n - m, "");
+static bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Length of the punctuator starting at s (at most n bytes available).
+static size_t punctLen(const char *s, size_t n) {
+  for (const char *p : PUNCTS) {
+    size_t len = strlen(p);
+    if (len <= n && !memcmp(s, p, len))
+      return len;
   }
-  input.pop_back();
+  return 1;
 }
 
-static void minifyOps(std::string &input) {
-  for (int i = 0; i < OPS.size(); i++) {
-    // Construct the regex pattern to strip away spaces around the operator
-    std::string toCompile = " *" + ESC_OPS[i] + " *";
-    std::regex regexPattern(toCompile);
+// Length of the backslash-newline splice at in[i], or 0.
+static size_t spliceLen(const std::string &in, size_t i) {
+  if (in[i] != '\\')
+    return 0;
+  if (i + 1 < in.size() && in[i + 1] == '\n')
+    return 2;
+  if (i + 2 < in.size() && in[i + 1] == '\r' && in[i + 2] == '\n')
+    return 3;
+  return 0;
+}
 
-    // Prepare replacement string
-    std::string repl = OPS[i];
+static bool isLiteralPrefix(const char *s, size_t n) {
+  for (const char *p : {"L", "u", "U", "u8", "R", "LR", "uR", "UR", "u8R"})
+    if (strlen(p) == n && !memcmp(s, p, n))
+      return true;
+  return false;
+}
 
-    // Lambda function to apply the regex and replacement
-    input = std::regex_replace(input, regexPattern, repl);
+// Scan a string or character literal whose opening quote is at i; returns
+// the offset just past it. Unterminated literals stop at the end of the line,
+// which is how stray apostrophes in #error lines get through untouched.
+static size_t scanQuoted(const std::string &in, size_t i) {
+  char quote = in[i++];
+  size_t n = in.size();
+  while (i < n) {
+    i = quote == '"' ? skip<NoneOf<'"', '\\', '\n'>>(in.data(), i, n)
+                     : skip<NoneOf<'\'', '\\', '\n'>>(in.data(), i, n);
+    if (i == n || in[i] != '\\')
+      break;
+    i = std::min(i + 2, n);
+  }
+  return i < n && in[i] == quote ? i + 1 : i;
+}
+
+// Scan R"delim( ... )delim" whose opening quote is at i.
+static size_t scanRawString(const std::string &in, size_t i) {
+  size_t open = in.find('(', i);
+  if (open == std::string::npos)
+    return scanQuoted(in, i);
+  std::string close = ")" + in.substr(i + 1, open - i - 1) + "\"";
+  size_t end = in.find(close, open);
+  return end == std::string::npos ? in.size() : end + close.size();
+}
 
-    // Handle special "else if"
-    input = std::regex_replace(input, std::regex("elseif"), "else if");
+/*
+ * Would the two tokens lex differently if printed without a space between
+ * them? Only consulted when the input had whitespace (or a comment) there, so
+ * tokens that were already adjacent are never pulled apart. prev is in the
+ * output, cur still in the input (both in buf).
+ */
+static bool needSpace(const char *buf, const Token &prev, const Token &cur) {
+  const char *a = buf + prev.begin, *b = buf + cur.begin;
+  size_t alen = prev.end - prev.begin, blen = cur.end - cur.begin;
+  unsigned char last = a[alen - 1], first = b[0];
+
+  if (prev.kind == TokKind::Other || cur.kind == TokKind::Other)
+    return true;
+  if (isIdentChar(last) && isIdentChar(first))
+    return true;
+  // An identifier right before a quote may become an encoding prefix, and a
+  // literal right before an identifier a C++ user-defined-literal suffix.
+  if (prev.kind == TokKind::Ident && cur.kind == TokKind::Literal)
+    return isLiteralPrefix(a, alen);
+  if (prev.kind == TokKind::Literal && cur.kind == TokKind::Ident)
+    return true;
+  // pp-numbers swallow '.', digit separators and exponent signs.
+  if (prev.kind == TokKind::Number &&
+      (first == '.' || first == '\'' ||
+       ((first == '+' || first == '-') && strchr("eEpP", last))))
+    return true;
+  if (last == '.' && (first == '.' || isDigit(first)))
+    return true;
+  // "/" followed by "/" or "*" would open a comment.
+  if (last == '/' && (first == '/' || first == '*'))
+    return true;
+  // Re-munch from the start of prev; a longer punctuator means they merge.
+  if (prev.kind == TokKind::Punct && cur.kind == TokKind::Punct) {
+    char buf[8];
+    size_t n = 0;
+    for (size_t k = 0; k < alen && k < 4; k++)
+      buf[n++] = a[k];
+    for (size_t k = 0; k < blen && k < 3; k++)
+      buf[n++] = b[k];
+    return punctLen(buf, n) > alen;
   }
+  return false;
 }
 
-static void stripNewLine(std::string &input) {
-  std::istringstream iss(input);
-  std::string line;
-  std::string result;
-  // this flag is needed to handle trailing backslashes in macros.
-  bool lastLineIsMacro = false;
+/*
+ * Single pass over the token stream: drop comments, blank lines and every
+ * space or newline that does not separate two tokens which would otherwise
+ * merge. Preprocessor directives keep their own line, with line continuations
+ * joined. String and character literals are copied verbatim.
+ *
+ * Works in place: the output is written to the front of the buffer, at w,
+ * while the input is read further on, at i. Nothing is written without
+ * consuming at least as much input first (a space or a newline before '#'
+ * only replaces whitespace that was skipped), so w never passes i.
+ */
+static void minify(std::string &in) {
+  char *buf = in.data();
+  size_t w = 0;
+  auto put = [&](char c) { buf[w++] = c; };
+
+  Token prev;
+  bool gap = false, lineStart = true, inDirective = false;
+  // Directive bookkeeping: token index within the directive and its name.
+  int dirTok = 0;
+  bool isDefine = false, isInclude = false;
 
-  while (std::getline(iss, line)) {
-    if (line.empty())
-      // Skip empty lines
+  size_t i = 0, n = in.size();
+  while (i < n) {
+    char c = in[i];
+    if (size_t len = spliceLen(in, i)) {
+      i += len;
       continue;
-    if (line.back() == '\\') {
-      // Remove trailing backslash
-      // DO NOT start a newline
-      line.pop_back();
-      result += line;
-      if (!lastLineIsMacro)
-        lastLineIsMacro = (line.front() == '#');
+    }
+    if (c == '\n') {
+      if (inDirective) {
+        put('\n');
+        inDirective = false;
+        prev = Token();
+      }
+      gap = lineStart = true;
+      i++;
+      continue;
+    }
+    if (isSpace(c)) {
+      gap = true;
+      i = skip<Blank>(buf, i + 1, n);
       continue;
     }
-    if (line.front() == '#') {
-      // Keep preprocessor's '\n', honoring the line above
-      result +=
-          ((!result.empty() && result.back() != '\n') ? '\n' + line : line) +
-          '\n';
+    if (c == '/' && i + 1 < n && in[i + 1] == '*') {
+      size_t end = in.find("*/", i + 2);
+      i = end == std::string::npos ? n : end + 2;
+      gap = true;
       continue;
     }
-    if (lastLineIsMacro) {
-      // We are in a macro and this line ends w/o a trailing backslash,
-      // which means now it's the end of the macro
-      result += line + '\n';
-      lastLineIsMacro = false;
+    if (c == '/' && i + 1 < n && in[i + 1] == '/') {
+      // A line comment ends at the first newline not spliced away.
+      while ((i = skip<NoneOf<'\n', '\\'>>(buf, i, n)) < n && in[i] != '\n')
+        i += spliceLen(in, i) ? spliceLen(in, i) : 1;
+      gap = true;
       continue;
     }
 
-    // Not special at all
-    // Remove '\n' from other regular lines
-    result += line;
-  }
+    Token cur;
+    cur.begin = i;
+    if (lineStart && c == '#') {
+      if (w && buf[w - 1] != '\n')
+        put('\n');
+      prev = Token();
+      inDirective = true;
+      dirTok = 0;
+      isDefine = isInclude = false;
+      cur.kind = TokKind::Punct;
+      i++;
+    } else if (inDirective && isInclude && dirTok == 2 && c == '<') {
+      size_t end = in.find_first_of(">\n", i);
+      if (end == std::string::npos)
+        i = n;
+      else
+        i = in[end] == '>' ? end + 1 : end;
+      cur.kind = TokKind::HeaderName;
+    } else if (isDigit(c) || (c == '.' && i + 1 < n && isDigit(in[i + 1]))) {
+      i++;
+      while (i < n) {
+        if (isIdentChar(in[i]) || in[i] == '.')
+          i++;
+        else if ((in[i] == '+' || in[i] == '-') && strchr("eEpP", in[i - 1]))
+          i++;
+        else if (in[i] == '\'' && i + 1 < n && isIdentChar(in[i + 1]))
+          i += 2;
+        else
+          break;
+      }
+      cur.kind = TokKind::Number;
+    } else if (isIdentChar(c)) {
+      i = skip<IdentChar>(buf, i + 1, n);
+      cur.kind = TokKind::Ident;
+      if (i < n && (in[i] == '"' || in[i] == '\'') &&
+          isLiteralPrefix(in.data() + cur.begin, i - cur.begin)) {
+        bool raw = in[i - 1] == 'R' && in[i] == '"';
+        i = raw ? scanRawString(in, i) : scanQuoted(in, i);
+        cur.kind = TokKind::Literal;
+      }
+    } else if (c == '"' || c == '\'') {
+      i = scanQuoted(in, i);
+      cur.kind = TokKind::Literal;
+    } else if (c && strchr("!%&()*+,-./:;<=>?[]^{|}~#", c)) {
+      i += punctLen(in.data() + i, n - i);
+      cur.kind = TokKind::Punct;
+    } else {
+      i++;
+      cur.kind = TokKind::Other;
+    }
+    // C++ user-defined-literal suffixes belong to the literal.
+    if (cur.kind == TokKind::Literal)
+      while (i < n && isIdentChar(in[i]))
+        i++;
+    cur.end = i;
 
-  input = result;
+    if (inDirective && dirTok == 1) {
+      size_t len = cur.end - cur.begin;
+      const char *s = in.data() + cur.begin;
+      isDefine = len == 6 && !memcmp(s, "define", 6);
+      isInclude = (len == 7 && !memcmp(s, "include", 7)) ||
+                  (len == 12 && !memcmp(s, "include_next", 12)) ||
+                  (len == 6 && !memcmp(s, "import", 6));
+    }
+    // "#define F (x)" is an object-like macro; keep the space after its name.
+    bool macroBody = inDirective && isDefine && dirTok == 3;
+    if (prev.kind != TokKind::None && gap &&
+        (macroBody || needSpace(buf, prev, cur)))
+      put(' ');
+
+    prev.kind = cur.kind;
+    prev.begin = w;
+    memmove(buf + w, buf + cur.begin, cur.end - cur.begin);
+    w += cur.end - cur.begin;
+    prev.end = w;
+    gap = lineStart = false;
+    if (inDirective)
+      dirTok++;
+  }
+  in.resize(w);
+  if (inDirective)
+    in += '\n';
 }
 
-void postProcess(std::string &code) {
-  removeComments(code);
-  minifyOps(code);
-  stripNewLine(code);
-}
\ No newline at end of file
+void postProcess(std::string &code) { minify(code); }
@@ -1,3 +1,5 @@
-#pragma include once
+#pragma once
 
-void postProcess(std::string &);
\ No newline at end of file
+#include <string>
+
+void postProcess(std::string &);
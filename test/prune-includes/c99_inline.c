@@ -0,0 +1,4 @@
+/* c99_inline.h is all that emits twice, and must stay. */
+#include "c99_inline.h"
+
+inline int twice(int x) { return 2 * x; }
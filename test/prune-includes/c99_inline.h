@@ -0,0 +1,3 @@
+/* Without inline, this declaration makes the inline definition in
+ * c99_inline.c an external one. */
+int twice(int x);
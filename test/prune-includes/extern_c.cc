@@ -0,0 +1,4 @@
+/* extern_c.h only declares what this file defines, and must stay. */
+#include "extern_c.h"
+
+int api(void) { return 42; }
@@ -0,0 +1,4 @@
+/* Gives api C linkage; the definition in extern_c.cc does not repeat it. */
+extern "C" {
+int api(void);
+}
@@ -0,0 +1,5 @@
+/* internal.h keeps helper out of the symbol table, and must stay. */
+#include "internal.h"
+
+int helper(void) { return 1; }
+int (*get_helper(void))(void) { return helper; }
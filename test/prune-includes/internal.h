@@ -0,0 +1,4 @@
+/* Gives helper internal linkage; the definition in internal.c does not
+ * repeat it. */
+static int helper(void);
+int (*get_helper(void))(void);
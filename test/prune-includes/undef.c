@@ -0,0 +1,9 @@
+/* undef.h decides which function this file defines, and must stay. */
+#define FAST 1
+#include "undef.h"
+
+#ifdef FAST
+int fast_path(void) { return 1; }
+#else
+int slow_path(void) { return 0; }
+#endif
@@ -0,0 +1,2 @@
+/* Only turns off a switch of the file including it. */
+#undef FAST
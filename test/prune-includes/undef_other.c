@@ -0,0 +1,10 @@
+/* LEGACY is tested while undef_other_off.h has undefined it, which must
+ * stay. */
+#include "undef_other.h"
+#include "undef_other_off.h"
+
+#if defined(LEGACY)
+int legacy_api(void) { return 1; }
+#else
+int modern_api(void) { return 2; }
+#endif
@@ -0,0 +1,2 @@
+/* Defines a switch for the headers after it. */
+#define LEGACY 1
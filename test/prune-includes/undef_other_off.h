@@ -0,0 +1,2 @@
+/* Turns off the switch undef_other.h defined. */
+#undef LEGACY
@@ -0,0 +1,36 @@
+get_filename_component(dir ${INPUT} DIRECTORY)
+get_filename_component(outdir ${OUTPUT} DIRECTORY)
+file(MAKE_DIRECTORY ${outdir})
+execute_process(
+  COMMAND ${MINIC} --prune-includes ${INPUT}
+  OUTPUT_FILE ${OUTPUT}
+  RESULT_VARIABLE res)
+if(res)
+  message(FATAL_ERROR "minic --prune-includes ${INPUT} failed: ${res}")
+endif()
+
+# The external symbols of the input compiled as is and as minified.
+function(symbols src var)
+  execute_process(
+    COMMAND ${COMPILER} -c -I${dir} ${src} -o ${src}.o
+    RESULT_VARIABLE res)
+  if(res)
+    message(FATAL_ERROR "${src} does not compile")
+  endif()
+  execute_process(
+    COMMAND ${NM} -g --defined-only ${src}.o
+    OUTPUT_VARIABLE out
+    RESULT_VARIABLE res)
+  if(res)
+    message(FATAL_ERROR "${NM} ${src}.o failed: ${res}")
+  endif()
+  string(REGEX REPLACE "[0-9a-fA-F]+ " "" out "${out}")
+  set(${var} "${out}" PARENT_SCOPE)
+endfunction()
+
+configure_file(${INPUT} ${OUTPUT}.orig${EXT} COPYONLY)
+symbols(${OUTPUT}.orig${EXT} before)
+symbols(${OUTPUT} after)
+if(NOT before STREQUAL after)
+  message(FATAL_ERROR "${OUTPUT} defines\n${after}instead of\n${before}")
+endif()
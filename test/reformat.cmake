@@ -0,0 +1,22 @@
+get_filename_component(outdir ${OUTPUT} DIRECTORY)
+file(MAKE_DIRECTORY ${outdir})
+foreach(mode direct reformat)
+  if(mode STREQUAL "reformat")
+    set(flag --reformat)
+  else()
+    set(flag)
+  endif()
+  execute_process(
+    COMMAND ${MINIC} ${flag} ${INPUT}
+    OUTPUT_FILE ${OUTPUT}.${mode}
+    RESULT_VARIABLE res)
+  if(res)
+    message(FATAL_ERROR "minic ${flag} ${INPUT} failed: ${res}")
+  endif()
+endforeach()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT}.direct
+                        ${OUTPUT}.reformat RESULT_VARIABLE res)
+if(res)
+  message(FATAL_ERROR "${OUTPUT}.direct and ${OUTPUT}.reformat differ")
+endif()
@@ -0,0 +1,15 @@
+/* close_file is only named in a cleanup attribute, and must survive
+ * --strip-dead. */
+#include <stdio.h>
+
+static void close_file(FILE **f) {
+  if (*f)
+    fclose(*f);
+}
+
+static int unused_helper(void) { return 1; }
+
+int main(void) {
+  FILE *f __attribute__((cleanup(close_file))) = fopen("/dev/null", "r");
+  return !f;
+}
@@ -0,0 +1,17 @@
+/* The allocator and the config type are only used by the header included
+ * after them, and must survive --strip-dead. */
+#include <stddef.h>
+
+typedef struct {
+  size_t size;
+} lib_config;
+
+static char pool[64];
+static void *pool_alloc(size_t size) { return size <= sizeof pool ? pool : 0; }
+#define LIB_MALLOC pool_alloc
+
+static int unused_helper(void) { return 1; }
+
+#include "header_use.h"
+
+int main(void) { return lib_buffer() == 0; }
@@ -0,0 +1,10 @@
+/* A single-file library, configured by macros and types its user defines
+ * before including it. */
+#ifndef LIB_MALLOC
+#include <stdlib.h>
+#define LIB_MALLOC malloc
+#endif
+
+static lib_config lib_defaults = {16};
+
+static void *lib_buffer(void) { return LIB_MALLOC(lib_defaults.size); }
@@ -0,0 +1,21 @@
+get_filename_component(dir ${INPUT} DIRECTORY)
+get_filename_component(outdir ${OUTPUT} DIRECTORY)
+file(MAKE_DIRECTORY ${outdir})
+execute_process(
+  COMMAND ${MINIC} --strip-dead ${INPUT}
+  OUTPUT_FILE ${OUTPUT}
+  RESULT_VARIABLE res)
+if(res)
+  message(FATAL_ERROR "minic --strip-dead ${INPUT} failed: ${res}")
+endif()
+
+file(READ ${OUTPUT} out)
+if(out MATCHES "unused_helper")
+  message(FATAL_ERROR "${OUTPUT} still defines unused_helper")
+endif()
+execute_process(
+  COMMAND ${CC} -c -I${dir} ${OUTPUT} -o ${OUTPUT}.o
+  RESULT_VARIABLE res)
+if(res)
+  message(FATAL_ERROR "${OUTPUT} does not compile")
+endif()